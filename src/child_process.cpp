@@ -0,0 +1,154 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "child_process.h"
+
+extern char **environ;
+
+
+// --- ChildProcess -----------------------------------------------------------------
+ChildProcess::ChildProcess() {
+	pid = -1;
+	pidfd = -1;
+	exited = false;
+	stop_requested = false;
+}
+
+ChildProcess::~ChildProcess() {
+	Stop();
+	if(pidfd != -1)
+		close(pidfd);
+}
+
+int ChildProcess::Start(const std::vector<std::string>& args) {
+	if(args.empty() || pid != -1)
+		return -1;
+	name = args[0];
+
+	int pipe_fds[2];
+	if(pipe2(pipe_fds, O_CLOEXEC)) {
+		perror("ChildProcess: error creating pipe");
+		return -1;
+	}
+
+	// connect stdout to the pipe (dup2 clears close-on-exec for the new fd)
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, pipe_fds[1], STDOUT_FILENO);
+
+	// the child shall not inherit our signal mask or ignored signals
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	sigset_t signals;
+	sigemptyset(&signals);
+	posix_spawnattr_setsigmask(&attr, &signals);
+	sigaddset(&signals, SIGPIPE);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGINT);
+	posix_spawnattr_setsigdefault(&attr, &signals);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+	std::vector<char*> argv;
+	for(const std::string& arg : args)
+		argv.push_back((char*) arg.c_str());
+	argv.push_back(NULL);
+
+	int result = posix_spawnp(&pid, argv[0], &actions, &attr, &argv[0], environ);
+	posix_spawn_file_actions_destroy(&actions);
+	posix_spawnattr_destroy(&attr);
+	close(pipe_fds[1]);
+
+	if(result) {
+		fprintf(stderr, "ChildProcess: error starting '%s': %s\n", name.c_str(), strerror(result));
+		close(pipe_fds[0]);
+		pid = -1;
+		return -1;
+	}
+
+#ifdef SYS_pidfd_open
+	// optional; older kernels lack pidfd support
+	pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+	return pipe_fds[0];
+}
+
+bool ChildProcess::Reap() {
+	if(exited)
+		return true;
+
+	int status;
+	pid_t result = waitpid(pid, &status, WNOHANG);
+	if(result == 0)
+		return false;
+	exited = true;
+
+	if(result == -1) {
+		perror("ChildProcess: error waiting for process");
+		return true;
+	}
+
+	// report unexpected exits
+	if(WIFEXITED(status) && WEXITSTATUS(status) != 0)
+		fprintf(stderr, "ChildProcess: '%s' (PID %d) exited with code %d\n", name.c_str(), pid, WEXITSTATUS(status));
+	if(WIFSIGNALED(status) && !stop_requested)
+		fprintf(stderr, "ChildProcess: '%s' (PID %d) was terminated by signal %d\n", name.c_str(), pid, WTERMSIG(status));
+	return true;
+}
+
+bool ChildProcess::WaitExit(int timeout_ms) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	while(!Reap()) {
+		int remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if(timeout_ms >= 0 && remaining_ms <= 0)
+			return false;
+
+		if(pidfd != -1) {
+			// the pidfd becomes readable, when the process exits
+			pollfd fds = {pidfd, POLLIN, 0};
+			if(poll(&fds, 1, timeout_ms >= 0 ? remaining_ms : -1) == -1 && errno != EINTR) {
+				perror("ChildProcess: error while poll");
+				return false;
+			}
+		} else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	return true;
+}
+
+bool ChildProcess::IsRunning() {
+	return pid != -1 && !Reap();
+}
+
+void ChildProcess::Stop() {
+	if(!IsRunning())
+		return;
+	stop_requested = true;
+
+	// (the PID cannot be reused meanwhile, as the process was not reaped yet)
+	if(kill(pid, SIGTERM))
+		perror("ChildProcess: error sending SIGTERM");
+	if(WaitExit(term_timeout_ms))
+		return;
+
+	fprintf(stderr, "ChildProcess: '%s' (PID %d) did not terminate in time; killing it\n", name.c_str(), pid);
+	if(kill(pid, SIGKILL))
+		perror("ChildProcess: error sending SIGKILL");
+	WaitExit(-1);
+}
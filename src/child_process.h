@@ -0,0 +1,72 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHILD_PROCESS_H_
+#define CHILD_PROCESS_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+
+// --- ChildProcess -----------------------------------------------------------------
+/* Runs a program (without shell) as child process, whose stdout is
+ * connected to a pipe. The read end is handed to the caller; all pipe ends
+ * are close-on-exec, so that concurrent children never inherit each
+ * other's pipe (which would prevent EOF when one of them exits).
+ *
+ * The child is watched via a pidfd (if supported by the kernel) or
+ * otherwise by polling waitpid(). On Stop() it is asked to terminate by
+ * SIGTERM and killed by SIGKILL if it did not exit in time.
+ */
+class ChildProcess {
+private:
+	std::string name;
+	pid_t pid;
+	int pidfd;
+	bool exited;
+	bool stop_requested;
+
+	bool Reap();
+	bool WaitExit(int timeout_ms);
+
+	static const int term_timeout_ms = 2000;
+public:
+	ChildProcess();
+	~ChildProcess();
+
+	int Start(const std::vector<std::string>& args);
+	void Stop();
+	bool IsRunning();
+	pid_t GetPID() {return pid;}
+};
+
+
+
+#endif /* CHILD_PROCESS_H_ */
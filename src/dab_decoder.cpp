@@ -18,36 +18,142 @@
 
 #include "dab_decoder.h"
 
-// --- MP2Decoder -----------------------------------------------------------------
+// --- MP2Header -----------------------------------------------------------------
 // from ETSI TS 103 466, table 4 (= ISO/IEC 11172-3, table B.2a):
-const int MP2Decoder::table_nbal_48a[] = {
+const int MP2Header::table_nbal_48a[] = {
 		4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
 		3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
 		2, 2, 2, 2
 };
 // from ETSI TS 103 466, table 5 (= ISO/IEC 11172-3, table B.2c):
-const int MP2Decoder::table_nbal_48b[] = {
+const int MP2Header::table_nbal_48b[] = {
 		4, 4,
 		3, 3, 3, 3, 3, 3
 };
 // from ETSI TS 103 466, table 6 (= ISO/IEC 13818-3, table B.1):
-const int MP2Decoder::table_nbal_24[] = {
+const int MP2Header::table_nbal_24[] = {
 		4, 4, 4, 4,
 		3, 3, 3, 3, 3, 3, 3,
 		2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2
 };
-const int* MP2Decoder::tables_nbal[] = {
+const int* MP2Header::tables_nbal[] = {
 		table_nbal_48a,
 		table_nbal_48b,
 		table_nbal_24
 };
-const int MP2Decoder::sblimits[] = {
+const int MP2Header::sblimits[] = {
 		sizeof(table_nbal_48a) / sizeof(int),
 		sizeof(table_nbal_48b) / sizeof(int),
 		sizeof(table_nbal_24) / sizeof(int),
 };
+const int MP2Header::bitrates_mpeg1[] = {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384};
+const int MP2Header::bitrates_mpeg2[] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160};
+const int MP2Header::samplerates_mpeg1[] = {44100, 48000, 32000};
+const int MP2Header::samplerates_mpeg2[] = {22050, 24000, 16000};
+
+
+bool MP2Header::Parse(uint32_t header) {
+	this->header = header;
+
+	// syncword, Layer II
+	if((header & 0xFFF00000) != 0xFFF00000 || (header & 0x00060000) != 0x00040000)
+		return false;
+
+	int bitrate_index = (header & 0x0000F000) >> 12;
+	int samplerate_index = (header & 0x00000C00) >> 10;
+	if(bitrate_index == 0 || bitrate_index == 15 || samplerate_index == 3)
+		return false;
+
+	mpeg1 = header & 0x00080000;
+	crc = !(header & 0x00010000);
+	bitrate = (mpeg1 ? bitrates_mpeg1 : bitrates_mpeg2)[bitrate_index];
+	samplerate = (mpeg1 ? samplerates_mpeg1 : samplerates_mpeg2)[samplerate_index];
+	mode = (header & 0x000000C0) >> 6;
+	mode_ext = (header & 0x00000030) >> 4;
+	return true;
+}
+
+std::string MP2Header::GetFormat() const {
+	const char* mode_string = "unknown";
+	switch(mode) {
+	case MODE_STEREO:
+		mode_string = "Stereo";
+		break;
+	case MODE_JOINT:
+		mode_string = "Joint Stereo";
+		break;
+	case MODE_DUAL:
+		mode_string = "Dual Channel";
+		break;
+	case MODE_MONO:
+		mode_string = "Mono";
+		break;
+	}
+
+	std::stringstream ss;
+	ss << "MPEG " << (mpeg1 ? "1.0" : "2.0") << " Layer II, ";
+	ss << (samplerate / 1000) << " kHz ";
+	ss << mode_string << " ";
+	ss << "@ " << bitrate << " kbit/s";
+	return ss.str();
+}
+
+bool MP2Header::CheckCRC(const uint8_t *body_data, size_t body_bytes) const {
+	// abort, if no CRC present (though required by DAB)
+	if(!crc)
+		return false;
+
+	// select matching nbal table
+	int nch = GetChannels();
+	int table_index = mpeg1 ? ((bitrate / nch) >= 56 ? 0 : 1) : 2;
+	const int* table_nbal = tables_nbal[table_index];
+
+	// count body bits covered by CRC (= allocation + ScFSI)
+	BitReader br(body_data + CalcCRC::CRCLen, body_bytes - CalcCRC::CRCLen);
+	size_t body_crc_len = 0;
+	int sblimit = sblimits[table_index];
+	int bound = mode == MODE_JOINT ? (mode_ext + 1) * 4 : sblimit;
+	for(int sb = 0; sb < bound; sb++) {
+		for(int ch = 0; ch < nch; ch++) {
+			int nbal = table_nbal[sb];
+			body_crc_len += nbal;
+
+			int index;
+			if(!br.GetBits(index, nbal))
+				return false;
+
+			if(index)
+				body_crc_len += 2;
+		}
+	}
+	for(int sb = bound; sb < sblimit; sb++) {
+		int nbal = table_nbal[sb];
+		body_crc_len += nbal;
+
+		int index;
+		if(!br.GetBits(index, nbal))
+			return false;
+
+		for(int ch = 0; ch < nch; ch++) {
+			if(index)
+				body_crc_len += 2;
+		}
+	}
+
+	// calc CRC
+	uint16_t crc_stored = (body_data[0] << 8) + body_data[1];
+	uint16_t crc_calced;
+	CalcCRC::CalcCRC_CRC16_IBM.Initialize(crc_calced);
+	CalcCRC::CalcCRC_CRC16_IBM.ProcessByte(crc_calced, (header & 0x0000FF00) >> 8);
+	CalcCRC::CalcCRC_CRC16_IBM.ProcessByte(crc_calced, header & 0x000000FF);
+	CalcCRC::CalcCRC_CRC16_IBM.ProcessBits(crc_calced, body_data + CalcCRC::CRCLen, body_crc_len);
+	CalcCRC::CalcCRC_CRC16_IBM.Finalize(crc_calced);
 
+	return crc_stored == crc_calced;
+}
 
+
+// --- MP2Decoder -----------------------------------------------------------------
 MP2Decoder::MP2Decoder(SubchannelSinkObserver* observer) : SubchannelSink(observer) {
 	scf_crc_len = -1;
 
@@ -165,62 +271,10 @@ size_t MP2Decoder::DecodeFrame(uint8_t **data) {
 }
 
 bool MP2Decoder::CheckCRC(const unsigned long& header, const uint8_t *body_data, const size_t& body_bytes) {
-	mpg123_frameinfo info;
-	int mpg_result = mpg123_info(handle, &info);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_info: " + std::string(mpg123_plain_strerror(mpg_result)));
-
-	// abort, if no CRC present (though required by DAB)
-	if(!(info.flags & MPG123_CRC))
+	MP2Header mp2_header;
+	if(!mp2_header.Parse(header))
 		return false;
-
-	// select matching nbal table
-	int nch = info.mode == MPG123_M_MONO ? 1 : 2;
-	int table_index = info.version == MPG123_1_0 ? ((info.bitrate / nch) >= 56 ? 0 : 1) : 2;
-	const int* table_nbal = tables_nbal[table_index];
-
-	// count body bits covered by CRC (= allocation + ScFSI)
-	BitReader br(body_data + CalcCRC::CRCLen, body_bytes - CalcCRC::CRCLen);
-	size_t body_crc_len = 0;
-	int sblimit = sblimits[table_index];
-	int bound = info.mode == MPG123_M_JOINT ? (info.mode_ext + 1) * 4 : sblimit;
-	for(int sb = 0; sb < bound; sb++) {
-		for(int ch = 0; ch < nch; ch++) {
-			int nbal = table_nbal[sb];
-			body_crc_len += nbal;
-
-			int index;
-			if(!br.GetBits(index, nbal))
-				return false;
-
-			if(index)
-				body_crc_len += 2;
-		}
-	}
-	for(int sb = bound; sb < sblimit; sb++) {
-		int nbal = table_nbal[sb];
-		body_crc_len += nbal;
-
-		int index;
-		if(!br.GetBits(index, nbal))
-			return false;
-
-		for(int ch = 0; ch < nch; ch++) {
-			if(index)
-				body_crc_len += 2;
-		}
-	}
-
-	// calc CRC
-	uint16_t crc_stored = (body_data[0] << 8) + body_data[1];
-	uint16_t crc_calced;
-	CalcCRC::CalcCRC_CRC16_IBM.Initialize(crc_calced);
-	CalcCRC::CalcCRC_CRC16_IBM.ProcessByte(crc_calced, (header & 0x0000FF00) >> 8);
-	CalcCRC::CalcCRC_CRC16_IBM.ProcessByte(crc_calced, header & 0x000000FF);
-	CalcCRC::CalcCRC_CRC16_IBM.ProcessBits(crc_calced, body_data + CalcCRC::CRCLen, body_crc_len);
-	CalcCRC::CalcCRC_CRC16_IBM.Finalize(crc_calced);
-
-	return crc_stored == crc_calced;
+	return mp2_header.CheckCRC(body_data, body_bytes);
 }
 
 void MP2Decoder::ProcessFormat() {
@@ -283,3 +337,64 @@ void MP2Decoder::ProcessFormat() {
 
 	observer->StartAudio(info.rate, info.mode != MPG123_M_MONO ? 2 : 1, true);
 }
+
+
+// --- MP2Passthrough -----------------------------------------------------------------
+MP2Passthrough::MP2Passthrough(SubchannelSinkObserver* observer) : SubchannelSink(observer) {
+	frame = new uint8_t[MP2Header::max_frame_len];
+	frame_len = 0;
+}
+
+MP2Passthrough::~MP2Passthrough() {
+	delete[] frame;
+}
+
+void MP2Passthrough::Feed(const uint8_t *data, size_t len) {
+	while(len) {
+		// (re-)sync on the next valid frame header
+		if(frame_len < MP2Header::header_len) {
+			frame[frame_len++] = *data++;
+			len--;
+
+			if(frame_len == MP2Header::header_len && !frame_header.Parse(frame)) {
+				memmove(frame, frame + 1, MP2Header::header_len - 1);
+				frame_len--;
+			}
+			continue;
+		}
+
+		// append the frame body
+		size_t copy_len = std::min(frame_header.GetFrameLen() - frame_len, len);
+		memcpy(frame + frame_len, data, copy_len);
+		frame_len += copy_len;
+		data += copy_len;
+		len -= copy_len;
+
+		if(frame_len == frame_header.GetFrameLen()) {
+			ProcessFrame();
+			frame_len = 0;
+		}
+	}
+}
+
+void MP2Passthrough::ProcessFrame() {
+	if(!format_header.header || !frame_header.IsSameFormat(format_header)) {
+		format_header = frame_header;
+		observer->FormatChange(frame_header.GetFormat());
+	}
+
+	const uint8_t *body_data = frame + MP2Header::header_len;
+	size_t body_bytes = frame_len - MP2Header::header_len;
+
+	// forwarding the whole frame (except ScF-CRC + F-PAD) as X-PAD, as we don't know the X-PAD len here
+	observer->ProcessPAD(body_data, body_bytes - FPAD_LEN - frame_header.GetScFCRCLen(), false, body_data + body_bytes - FPAD_LEN);
+
+	// check CRC (MP2's CRC only - not DAB's ScF-CRC)
+	if(!frame_header.CheckCRC(body_data, body_bytes)) {
+		fprintf(stderr, "\x1B[31m" "(CRC)" "\x1B[0m" " ");
+		// no PAD reset, as not covered by CRC
+		return;
+	}
+
+	observer->PutAudio(frame, frame_len);
+}
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <algorithm>
 #include <stdexcept>
 #include <sstream>
 #include <string>
@@ -35,6 +36,53 @@
 #include "tools.h"
 
 
+// --- MP2Header -----------------------------------------------------------------
+// header of an MPEG-1/2 Audio Layer II frame (parsed without mpg123)
+class MP2Header {
+private:
+	static const int table_nbal_48a[];
+	static const int table_nbal_48b[];
+	static const int table_nbal_24[];
+	static const int* tables_nbal[];
+	static const int sblimits[];
+
+	static const int bitrates_mpeg1[];
+	static const int bitrates_mpeg2[];
+	static const int samplerates_mpeg1[];
+	static const int samplerates_mpeg2[];
+public:
+	enum Mode {
+		MODE_STEREO = 0,
+		MODE_JOINT = 1,
+		MODE_DUAL = 2,
+		MODE_MONO = 3
+	};
+
+	uint32_t header;
+	bool mpeg1;			// otherwise MPEG-2 LSF
+	bool crc;
+	int bitrate;		// kbit/s
+	int samplerate;
+	int mode;
+	int mode_ext;
+
+	MP2Header() : header(0), mpeg1(false), crc(false), bitrate(0), samplerate(0), mode(MODE_STEREO), mode_ext(0) {}
+
+	static const size_t header_len = 4;
+	static const size_t max_frame_len = 144 * 384 * 1000 / 32000 + 1;	// incl. padding
+
+	bool Parse(uint32_t header);
+	bool Parse(const uint8_t *data) {return Parse(((uint32_t) data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);}
+	bool IsSameFormat(const MP2Header& other) const {return (header & 0xFFFFFCC0) == (other.header & 0xFFFFFCC0);}
+
+	size_t GetFrameLen() const {return 144 * bitrate * 1000 / samplerate + ((header & 0x00000200) ? 1 : 0);}
+	int GetChannels() const {return mode == MODE_MONO ? 1 : 2;}
+	int GetScFCRCLen() const {return (mpeg1 && bitrate < (mode == MODE_MONO ? 56 : 112)) ? 2 : 4;}
+	std::string GetFormat() const;
+	bool CheckCRC(const uint8_t *body_data, size_t body_bytes) const;
+};
+
+
 // --- MP2Decoder -----------------------------------------------------------------
 class MP2Decoder : public SubchannelSink {
 private:
@@ -45,12 +93,6 @@ private:
 	void ProcessFormat();
 	size_t DecodeFrame(uint8_t **data);
 	bool CheckCRC(const unsigned long& header, const uint8_t *body_data, const size_t& body_bytes);
-
-	static const int table_nbal_48a[];
-	static const int table_nbal_48b[];
-	static const int table_nbal_24[];
-	static const int* tables_nbal[];
-	static const int sblimits[];
 public:
 	MP2Decoder(SubchannelSinkObserver* observer);
 	~MP2Decoder();
@@ -58,4 +100,24 @@ public:
 	void Feed(const uint8_t *data, size_t len);
 };
 
+
+// --- MP2Passthrough -----------------------------------------------------------------
+// Outputs the (CRC checked) MP2 frames of a DAB service without decoding
+// them. The frame boundaries are found by the frame headers, so that mpg123
+// is not used at all.
+class MP2Passthrough : public SubchannelSink {
+private:
+	uint8_t *frame;
+	size_t frame_len;		// bytes currently buffered
+	MP2Header frame_header;
+	MP2Header format_header;
+
+	void ProcessFrame();
+public:
+	MP2Passthrough(SubchannelSinkObserver* observer);
+	~MP2Passthrough();
+
+	void Feed(const uint8_t *data, size_t len);
+};
+
 #endif /* DAB_DECODER_H_ */
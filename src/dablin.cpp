@@ -39,7 +39,27 @@ static void usage(const char* exe) {
 					"  -R <subchid>  ID of the sub-channel (DAB+) to be played\n"
 					"  -g <gain>     USB stick gain to pass to DAB live source (auto gain is default)\n"
 					"  -p            Output PCM to stdout instead of using SDL\n"
-					"  file          Input file to be played (stdin, if not specified)\n"
+					"  -u            Decode as fast as possible, without flow control (requires PCM output)\n"
+					"  -j <jobs>     Decode a recording in parallel using the mentioned number of threads\n"
+					"                (implies -u; requires PCM output and a file)\n"
+					"  -m <dir>      Decode all audio services at once, writing PCM files into the mentioned directory\n"
+					"                (-j then sets the number of decoder threads)\n"
+					"  -q <len>      Decode in a pipeline of threads, using queues of the mentioned length\n"
+					"                (either one length for all queues or three comma-separated lengths: frames,sub-channel,audio)\n"
+					"  -Q            Drop data instead of waiting, if a pipeline queue is full (requires -q)\n"
+					"  -S            Discard the sub-channel data of ETI frames with wrong body (EOF) CRC\n"
+					"  -w <file>     Capture the FIC and sub-channels into the mentioned file (can be replayed as input file)\n"
+					"  -W <subchids> Capture only the mentioned sub-channels (comma-separated; requires -w)\n"
+					"  -o <seconds>  Start playback of a recording at the mentioned position\n"
+					"  -t            Follow a recording which is still being written (wait for new frames at its end)\n"
+					"  -T <minutes>  Keep the mentioned number of minutes for timeshift (requires DAB live source, stdin or network;\n"
+					"                ring file of ~15 MB per minute in $TMPDIR or /var/tmp, which should not be a tmpfs;\n"
+					"                keys: p = pause/resume, b/f = 10s back/forward, l = live)\n"
+					"  -P <format>   Output the audio without decoding: DAB+ AUs in the mentioned format (adts or latm),\n"
+					"                DAB as MP2 frames (requires PCM output or -m)\n"
+					"  file          Input file to be played (stdin, if not specified) or network address:\n"
+					"                tcp://host:port (connect), tcp://:port (listen) or udp://[host]:port (multicast group as host);\n"
+					"                with prefix edi+ (e.g. edi+udp://:port) EDI is received instead of ETI\n"
 			);
 	exit(1);
 }
@@ -61,7 +81,7 @@ int main(int argc, char **argv) {
 
 	// option args
 	int c;
-	while((c = getopt(argc, argv, "hc:d:g:s:x:pr:R:")) != -1) {
+	while((c = getopt(argc, argv, "hc:d:g:s:x:puj:m:q:QSP:w:W:o:tT:r:R:")) != -1) {
 		switch(c) {
 		case 'h':
 			usage(argv[0]);
@@ -93,6 +113,54 @@ int main(int argc, char **argv) {
 		case 'p':
 			options.pcm_output = true;
 			break;
+		case 'u':
+			options.unpaced = true;
+			break;
+		case 'j':
+			options.jobs = strtol(optarg, NULL, 0);
+			break;
+		case 'm':
+			options.multi_output_dir = optarg;
+			break;
+		case 'q': {
+			string_vector_t lens = MiscTools::SplitString(optarg, ',');
+			if(lens.size() != 1 && lens.size() != 3)
+				usage(argv[0]);
+			options.pipeline.frame_queue_len = strtol(lens[0].c_str(), NULL, 0);
+			options.pipeline.subchannel_queue_len = strtol(lens[lens.size() == 3 ? 1 : 0].c_str(), NULL, 0);
+			options.pipeline.audio_queue_len = strtol(lens[lens.size() == 3 ? 2 : 0].c_str(), NULL, 0);
+			break; }
+		case 'Q':
+			options.pipeline.drop_when_full = true;
+			break;
+		case 'S':
+			options.strict_body_crc = true;
+			break;
+		case 'w':
+			options.capture_filename = optarg;
+			break;
+		case 'W': {
+			string_vector_t subchids = MiscTools::SplitString(optarg, ',');
+			for(const std::string& subchid : subchids)
+				options.capture_subchids.push_back(strtol(subchid.c_str(), NULL, 0));
+			break; }
+		case 'o':
+			options.start_seconds = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			options.tail = true;
+			break;
+		case 'T':
+			options.timeshift_minutes = strtol(optarg, NULL, 0);
+			break;
+		case 'P':
+			if(!strcmp(optarg, "adts"))
+				options.passthrough_format = PASSTHROUGH_ADTS;
+			else if(!strcmp(optarg, "latm"))
+				options.passthrough_format = PASSTHROUGH_LATM;
+			else
+				usage(argv[0]);
+			break;
 		case '?':
 		default:
 			usage(argv[0]);
@@ -110,6 +178,10 @@ int main(int argc, char **argv) {
 		usage(argv[0]);
 	}
 
+	// parallel decoding of a single service is always done as fast as possible
+	if(options.jobs && options.multi_output_dir.empty())
+		options.unpaced = true;
+
 	// ensure valid options
 	if(options.dab_live_source_binary.empty()) {
 		if(!options.initial_channel.empty()) {
@@ -134,8 +206,100 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "The service component ID requires the service ID to be specified!\n");
 		usage(argv[0]);
 	}
+	if(options.unpaced && !options.pcm_output && options.multi_output_dir.empty()) {
+		fprintf(stderr, "Decoding without flow control requires PCM output!\n");
+		usage(argv[0]);
+	}
+	if(options.unpaced && !options.dab_live_source_binary.empty()) {
+		fprintf(stderr, "Decoding without flow control cannot be used with DAB live source!\n");
+		usage(argv[0]);
+	}
+	if(options.pipeline.frame_queue_len || options.pipeline.subchannel_queue_len || options.pipeline.audio_queue_len) {
+		if(options.pipeline.IsNone()) {
+			fprintf(stderr, "All pipeline queues must have a length of at least one!\n");
+			usage(argv[0]);
+		}
+		if(options.jobs || !options.multi_output_dir.empty()) {
+			fprintf(stderr, "The pipeline cannot be combined with parallel decoding!\n");
+			usage(argv[0]);
+		}
+	}
+	if(options.pipeline.drop_when_full) {
+		if(options.pipeline.IsNone()) {
+			fprintf(stderr, "Dropping data requires the pipeline to be used!\n");
+			usage(argv[0]);
+		}
+		if(options.unpaced) {
+			fprintf(stderr, "Dropping data cannot be used when decoding without flow control!\n");
+			usage(argv[0]);
+		}
+	}
+	if(options.passthrough_format != PASSTHROUGH_NONE) {
+		if(!options.pcm_output && options.multi_output_dir.empty()) {
+			fprintf(stderr, "Passing through the audio requires PCM output!\n");
+			usage(argv[0]);
+		}
+		if(options.jobs && options.multi_output_dir.empty()) {
+			fprintf(stderr, "Passing through the audio cannot be combined with parallel decoding!\n");
+			usage(argv[0]);
+		}
+	}
+	if(!options.capture_subchids.empty() && options.capture_filename.empty()) {
+		fprintf(stderr, "Capturing only some sub-channels requires a capture file!\n");
+		usage(argv[0]);
+	}
+	if(!options.capture_filename.empty() && options.jobs && options.multi_output_dir.empty()) {
+		fprintf(stderr, "Capturing cannot be combined with parallel decoding!\n");
+		usage(argv[0]);
+	}
+	if(options.start_seconds) {
+		if(options.start_seconds < 0) {
+			fprintf(stderr, "The start position must not be negative!\n");
+			usage(argv[0]);
+		}
+		if(options.filename.empty() || ETINetworkSource::IsNetworkAddress(options.filename)) {
+			fprintf(stderr, "Starting at a position requires a file as source!\n");
+			usage(argv[0]);
+		}
+		if(options.jobs && options.multi_output_dir.empty()) {
+			fprintf(stderr, "Starting at a position cannot be combined with parallel decoding!\n");
+			usage(argv[0]);
+		}
+	}
+	if(options.tail) {
+		if(!options.dab_live_source_binary.empty()) {
+			fprintf(stderr, "Following a recording cannot be used with DAB live source!\n");
+			usage(argv[0]);
+		}
+		if(ETINetworkSource::IsNetworkAddress(options.filename)) {
+			fprintf(stderr, "Following a recording cannot be used with a network source!\n");
+			usage(argv[0]);
+		}
+		if(ETICaptureSource::IsCaptureFile(options.filename)) {
+			fprintf(stderr, "Following a recording cannot be used with a capture file!\n");
+			usage(argv[0]);
+		}
+		if(options.jobs && options.multi_output_dir.empty()) {
+			fprintf(stderr, "Following a recording cannot be combined with parallel decoding!\n");
+			usage(argv[0]);
+		}
+	}
+	if(options.timeshift_minutes) {
+		if(options.timeshift_minutes < 0) {
+			fprintf(stderr, "The timeshift window must not be negative!\n");
+			usage(argv[0]);
+		}
+		if(!options.filename.empty() && !ETINetworkSource::IsNetworkAddress(options.filename)) {
+			fprintf(stderr, "Timeshift requires DAB live source, stdin or network as source!\n");
+			usage(argv[0]);
+		}
+		if(options.unpaced || options.jobs) {
+			fprintf(stderr, "Timeshift cannot be combined with decoding without flow control or parallel decoding!\n");
+			usage(argv[0]);
+		}
+	}
 #ifdef DABLIN_DISABLE_SDL
-	if(!options.pcm_output) {
+	if(!options.pcm_output && options.multi_output_dir.empty()) {
 		fprintf(stderr, "SDL output was disabled, so PCM output must be selected!\n");
 		usage(argv[0]);
 	}
@@ -147,6 +311,29 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "At most one SId or SubChId shall be specified!\n");
 		usage(argv[0]);
 	}
+	if(!options.multi_output_dir.empty()) {
+		if(id_param_count) {
+			fprintf(stderr, "Decoding all audio services cannot be combined with a SId or SubChId!\n");
+			usage(argv[0]);
+		}
+		if(options.jobs < 0) {
+			fprintf(stderr, "At least one decoder thread is required!\n");
+			usage(argv[0]);
+		}
+	} else if(options.jobs) {
+		if(options.jobs < 1) {
+			fprintf(stderr, "At least one job is required for parallel decoding!\n");
+			usage(argv[0]);
+		}
+		if(options.filename.empty() || ETINetworkSource::IsNetworkAddress(options.filename)) {
+			fprintf(stderr, "Parallel decoding requires a file as source!\n");
+			usage(argv[0]);
+		}
+		if(id_param_count == 0) {
+			fprintf(stderr, "Parallel decoding requires a SId or SubChId to be specified!\n");
+			usage(argv[0]);
+		}
+	}
 
 
 	fprint_dablin_banner(stderr);
@@ -167,7 +354,30 @@ DABlinText::DABlinText(DABlinTextOptions options) {
 	// set XTerm window title to version string
 	fprintf(stderr, "\x1B]0;" "DABlin v" DABLIN_VERSION "\a");
 
-	eti_player = new ETIPlayer(options.pcm_output, this);
+	eti_source = NULL;
+	eti_player = NULL;
+	eti_multi_player = NULL;
+	fic_decoder = NULL;
+	eti_transcoder = NULL;
+	eti_capture_writer = NULL;
+	eti_timeshift = NULL;
+	keys_exit = false;
+
+	// parallel decoding uses its own players
+	if(options.jobs && options.multi_output_dir.empty()) {
+		eti_transcoder = new ETITranscoder(options.filename, options.jobs);
+		return;
+	}
+
+	if(options.multi_output_dir.empty()) {
+		eti_player = new ETIPlayer(options.pcm_output, options.unpaced, this, options.pipeline);
+		eti_player->SetStrictBodyCRC(options.strict_body_crc);
+		eti_player->SetPassthrough(options.passthrough_format);
+	} else {
+		eti_multi_player = new ETIMultiPlayer(options.multi_output_dir, options.jobs, options.unpaced, this);
+		eti_multi_player->SetStrictBodyCRC(options.strict_body_crc);
+		eti_multi_player->SetPassthrough(options.passthrough_format);
+	}
 
 	// set initial sub-channel, if desired
 	if(options.initial_subchid_dab != AUDIO_SERVICE::subchid_none) {
@@ -183,21 +393,196 @@ DABlinText::DABlinText(DABlinTextOptions options) {
 		fprintf(stderr, "\x1B]0;" "Sub-channel %d (DAB+) - DABlin" "\a", options.initial_subchid_dab_plus);
 	}
 
-	if(options.dab_live_source_binary.empty())
-		eti_source = new ETISource(options.filename, this);
+	if(!options.capture_filename.empty()) {
+		eti_capture_writer = new ETICaptureWriter(true, options.capture_subchids);
+		if(!eti_capture_writer->Open(options.capture_filename)) {
+			delete eti_capture_writer;
+			eti_capture_writer = NULL;
+		}
+	}
+
+	// with timeshift, the frames take a detour
+	ETISourceObserver *source_observer = this;
+	if(options.timeshift_minutes) {
+		eti_timeshift = new ETITimeshift(this, options.timeshift_minutes * 60 * 1000 / 24);
+		if(eti_timeshift->Open()) {
+			source_observer = eti_timeshift;
+		} else {
+			delete eti_timeshift;
+			eti_timeshift = NULL;
+		}
+	}
+
+	if(ETICaptureSource::IsCaptureFile(options.filename))
+		eti_source = new ETICaptureSource(options.filename, source_observer);
+	else if(EDISource::IsEDIAddress(options.filename))
+		eti_source = new EDISource(options.filename, source_observer);
+	else if(ETINetworkSource::IsNetworkAddress(options.filename))
+		eti_source = new ETINetworkSource(options.filename, source_observer);
+	else if(options.dab_live_source_binary.empty())
+		eti_source = new ETISource(options.filename, source_observer);
 	else
-		eti_source = new DABLiveETISource(options.dab_live_source_binary, DAB_LIVE_SOURCE_CHANNEL(dab_channels.at(options.initial_channel), options.gain), this);
+		eti_source = new DABLiveETISource(options.dab_live_source_binary, DAB_LIVE_SOURCE_CHANNEL(dab_channels.at(options.initial_channel), options.gain), source_observer);
+	eti_source->SetTail(options.tail);
 
 	fic_decoder = new FICDecoder(this);
 }
 
 DABlinText::~DABlinText() {
 	DoExit();
+	delete eti_transcoder;
 	delete eti_source;
+	delete eti_timeshift;
+	delete eti_capture_writer;
 	delete eti_player;
+	delete eti_multi_player;
 	delete fic_decoder;
 }
 
+void DABlinText::DoExit() {
+	if(eti_transcoder)
+		eti_transcoder->DoExit();
+	else
+		eti_source->DoExit();
+
+	if(eti_timeshift)
+		eti_timeshift->DoExit();
+	keys_exit = true;
+}
+
+int DABlinText::Main() {
+	if(eti_transcoder)
+		return MainTranscoder();
+
+	if(options.start_seconds)
+		eti_source->Seek(options.start_seconds * 1000 / 24);
+
+	if(eti_timeshift)
+		keys_thread = std::thread(&DABlinText::TimeshiftKeysLoop, this);
+
+	int result = eti_source->Main();
+
+	// play the frames still pending within the timeshift
+	if(eti_timeshift) {
+		eti_timeshift->WaitCaughtUp();
+		eti_timeshift->DoExit();
+		keys_exit = true;
+		keys_thread.join();
+	}
+
+	// process any data still pending in the pipeline
+	if(eti_player)
+		eti_player->Flush();
+
+	if(options.unpaced) {
+		if(eti_multi_player)
+			eti_multi_player->PrintSpeed();
+		else
+			eti_player->PrintSpeed();
+	}
+
+	size_t body_crc_errors = eti_multi_player ? eti_multi_player->GetBodyCRCErrors() : eti_player->GetBodyCRCErrors();
+	if(body_crc_errors)
+		fprintf(stderr, "DABlinText: %zu ETI frame(s) with wrong body CRC%s\n", body_crc_errors, options.strict_body_crc ? " discarded" : "");
+	return result;
+}
+
+int DABlinText::MainTranscoder() {
+	if(!eti_transcoder->Open())
+		return 1;
+
+	// determine the desired sub-channel
+	AUDIO_SERVICE audio_service;
+	if(options.initial_subchid_dab != AUDIO_SERVICE::subchid_none)
+		audio_service = AUDIO_SERVICE(options.initial_subchid_dab, false);
+	if(options.initial_subchid_dab_plus != AUDIO_SERVICE::subchid_none)
+		audio_service = AUDIO_SERVICE(options.initial_subchid_dab_plus, true);
+	if(options.initial_sid != LISTED_SERVICE::sid_none) {
+		audio_service = eti_transcoder->FindAudioService(options.initial_sid, options.initial_scids);
+		if(audio_service.IsNone()) {
+			fprintf(stderr, "DABlinText: the desired service was not found at the beginning of the recording!\n");
+			return 1;
+		}
+	}
+
+	return eti_transcoder->Main(audio_service);
+}
+
+void DABlinText::TimeshiftKeysLoop() {
+	// the keys are read from the terminal, as stdin may provide the ETI stream
+	int tty_fd = open("/dev/tty", O_RDONLY);
+	if(tty_fd == -1) {
+		perror("DABlinText: error opening terminal for timeshift control");
+		return;
+	}
+
+	// get single keys without echo
+	termios old_attr;
+	bool attr_changed = false;
+	if(tcgetattr(tty_fd, &old_attr) == 0) {
+		termios attr = old_attr;
+		attr.c_lflag &= ~(ICANON | ECHO);
+		attr.c_cc[VMIN] = 1;
+		attr.c_cc[VTIME] = 0;
+		attr_changed = tcsetattr(tty_fd, TCSANOW, &attr) == 0;
+	}
+
+	fd_set fds;
+	timeval select_timeval;
+
+	while(!keys_exit) {
+		FD_ZERO(&fds);
+		FD_SET(tty_fd, &fds);
+
+		select_timeval.tv_sec = 0;
+		select_timeval.tv_usec = 100 * 1000;
+
+		int ready_fds = select(tty_fd + 1, &fds, NULL, NULL, &select_timeval);
+		if(ready_fds == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("DABlinText: error while select");
+			break;
+		}
+		if(!(ready_fds && FD_ISSET(tty_fd, &fds)))
+			continue;
+
+		char key;
+		if(read(tty_fd, &key, 1) != 1)
+			break;
+
+		switch(key) {
+		case 'p':
+		case ' ':
+			eti_timeshift->Pause(!eti_timeshift->IsPaused());
+			break;
+		case 'b':
+			eti_timeshift->Skip(-timeshift_skip_seconds);
+			break;
+		case 'f':
+			eti_timeshift->Skip(timeshift_skip_seconds);
+			break;
+		case 'l':
+			eti_timeshift->CatchUp();
+			break;
+		}
+	}
+
+	if(attr_changed)
+		tcsetattr(tty_fd, TCSANOW, &old_attr);
+	close(tty_fd);
+}
+
+void DABlinText::ETIProcessFrame(const uint8_t *data) {
+	if(eti_capture_writer)
+		eti_capture_writer->ProcessFrame(data);
+
+	if(eti_multi_player)
+		eti_multi_player->ProcessFrame(data);
+	else
+		eti_player->ProcessFrame(data);
+}
+
 void DABlinText::ETIUpdateProgress(const ETI_PROGRESS progress) {
 	// compensate cursor movement
 	std::string format = "\x1B[34m" "%s" "\x1B[0m";
@@ -206,9 +591,22 @@ void DABlinText::ETIUpdateProgress(const ETI_PROGRESS progress) {
 	fprintf(stderr, format.c_str(), progress.text.c_str());
 }
 
+void DABlinText::ETIRestoreFIC(const uint8_t *data, size_t len) {
+	// after a seek: let the pipeline (if any) finish the previous position, as it also feeds the FIC decoder
+	if(eti_player)
+		eti_player->Flush();
+	fic_decoder->Process(data, len);
+}
+
 void DABlinText::FICChangeService(const LISTED_SERVICE& service) {
 //	fprintf(stderr, "### FICChangeService\n");
 
+	// decode all audio services, if desired
+	if(eti_multi_player) {
+		eti_multi_player->AddService(service);
+		return;
+	}
+
 	// abort, if no/not initial service
 	if(options.initial_sid == LISTED_SERVICE::sid_none || service.sid != options.initial_sid || service.scids != options.initial_scids)
 		return;
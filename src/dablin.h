@@ -20,10 +20,19 @@
 #define DABLIN_H_
 
 #include <signal.h>
+#include <atomic>
 #include <string>
+#include <thread>
+#include <termios.h>
 
 #include "eti_source.h"
+#include "eti_capture.h"
+#include "edi_source.h"
+#include "eti_network_source.h"
+#include "eti_timeshift.h"
 #include "eti_player.h"
+#include "eti_multi_player.h"
+#include "eti_transcoder.h"
 #include "fic_decoder.h"
 #include "tools.h"
 #include "version.h"
@@ -39,6 +48,17 @@ struct DABlinTextOptions {
 	std::string dab_live_source_binary;
 	std::string initial_channel;
 	bool pcm_output;
+	bool unpaced;
+	int jobs;
+	std::string multi_output_dir;
+	ETI_PIPELINE_CONFIG pipeline;
+	bool strict_body_crc;
+	PASSTHROUGH_FORMAT passthrough_format;
+	std::string capture_filename;
+	std::vector<int> capture_subchids;
+	int start_seconds;
+	bool tail;
+	int timeshift_minutes;
 	int gain;
 DABlinTextOptions() :
 	initial_sid(LISTED_SERVICE::sid_none),
@@ -46,6 +66,13 @@ DABlinTextOptions() :
 	initial_subchid_dab(AUDIO_SERVICE::subchid_none),
 	initial_subchid_dab_plus(AUDIO_SERVICE::subchid_none),
 	pcm_output(false),
+	unpaced(false),
+	jobs(0),
+	strict_body_crc(false),
+	passthrough_format(PASSTHROUGH_NONE),
+	start_seconds(0),
+	tail(false),
+	timeshift_minutes(0),
 	gain(DAB_LIVE_SOURCE_CHANNEL::auto_gain)
 	{}
 };
@@ -58,17 +85,30 @@ private:
 
 	ETISource *eti_source;
 	ETIPlayer *eti_player;
+	ETIMultiPlayer *eti_multi_player;
 	FICDecoder *fic_decoder;
+	ETITranscoder *eti_transcoder;
+	ETICaptureWriter *eti_capture_writer;
+	ETITimeshift *eti_timeshift;
 
-	void ETIProcessFrame(const uint8_t *data) {eti_player->ProcessFrame(data);};
+	std::thread keys_thread;
+	std::atomic<bool> keys_exit;
+
+	int MainTranscoder();
+	void TimeshiftKeysLoop();
+
+	static const int timeshift_skip_seconds = 10;
+
+	void ETIProcessFrame(const uint8_t *data);
 	void ETIUpdateProgress(const ETI_PROGRESS progress);
+	void ETIRestoreFIC(const uint8_t *data, size_t len);
 	void ETIProcessFIC(const uint8_t *data, size_t len) {fic_decoder->Process(data, len);}
 	void FICChangeService(const LISTED_SERVICE& service);
 public:
 	DABlinText(DABlinTextOptions options);
 	~DABlinText();
-	void DoExit() {eti_source->DoExit();}
-	int Main() {return eti_source->Main();}
+	void DoExit();
+	int Main();
 };
 
 
@@ -41,7 +41,12 @@ static void usage(const char* exe) {
 					"  -p           Output PCM to stdout instead of using SDL\n"
 					"  -S           Initially disable slideshow\n"
 					"  -L           Enable loose behaviour (e.g. PAD conformance)\n"
-					"  file         Input file to be played (stdin, if not specified)\n"
+					"  -t           Follow a recording which is still being written (wait for new frames at its end)\n"
+					"  -T <minutes> Keep the mentioned number of minutes for timeshift (requires DAB live source, stdin or network;\n"
+					"               ring file of ~15 MB per minute in $TMPDIR or /var/tmp, which should not be a tmpfs)\n"
+					"  file         Input file to be played (stdin, if not specified) or network address:\n"
+					"               tcp://host:port (connect), tcp://:port (listen) or udp://[host]:port (multicast group as host);\n"
+					"               with prefix edi+ (e.g. edi+udp://:port) EDI is received instead of ETI\n"
 			);
 	exit(1);
 }
@@ -62,7 +67,7 @@ int main(int argc, char **argv) {
 
 	// option args
 	int c;
-	while((c = getopt(argc, argv, "hd:C:c:g:s:x:pSL")) != -1) {
+	while((c = getopt(argc, argv, "hd:C:c:g:s:x:pSLtT:")) != -1) {
 		switch(c) {
 		case 'h':
 			usage(argv[0]);
@@ -94,6 +99,12 @@ int main(int argc, char **argv) {
 		case 'L':
 			options.loose = true;
 			break;
+		case 't':
+			options.tail = true;
+			break;
+		case 'T':
+			options.timeshift_minutes = strtol(optarg, NULL, 0);
+			break;
 		case '?':
 		default:
 			usage(argv[0]);
@@ -135,6 +146,26 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "The service component ID requires the service ID to be specified!\n");
 		usage(argv[0]);
 	}
+	if(options.tail && !options.dab_live_source_binary.empty()) {
+		fprintf(stderr, "Following a recording cannot be used with DAB live source!\n");
+		usage(argv[0]);
+	}
+	if(options.tail && ETINetworkSource::IsNetworkAddress(options.filename)) {
+		fprintf(stderr, "Following a recording cannot be used with a network source!\n");
+		usage(argv[0]);
+	}
+	if(options.tail && ETICaptureSource::IsCaptureFile(options.filename)) {
+		fprintf(stderr, "Following a recording cannot be used with a capture file!\n");
+		usage(argv[0]);
+	}
+	if(options.timeshift_minutes < 0) {
+		fprintf(stderr, "The timeshift window must not be negative!\n");
+		usage(argv[0]);
+	}
+	if(options.timeshift_minutes && !options.filename.empty() && !ETINetworkSource::IsNetworkAddress(options.filename)) {
+		fprintf(stderr, "Timeshift requires DAB live source, stdin or network as source!\n");
+		usage(argv[0]);
+	}
 #ifdef DABLIN_DISABLE_SDL
 	if(!options.pcm_output) {
 		fprintf(stderr, "SDL output was disabled, so PCM output must be selected!\n");
@@ -162,6 +193,7 @@ DABlinGTK::DABlinGTK(DABlinGTKOptions options) {
 	this->options = options;
 
 	initial_channel_appended = false;
+	progress_frames_total = 0;
 
 	slideshow_window.set_transient_for(*this);
 
@@ -172,12 +204,30 @@ DABlinGTK::DABlinGTK(DABlinGTKOptions options) {
 	pad_change_dynamic_label.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::PADChangeDynamicLabelEmitted));
 	pad_change_slide.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::PADChangeSlideEmitted));
 
-	eti_player = new ETIPlayer(options.pcm_output, this);
+	eti_player = new ETIPlayer(options.pcm_output, false, this);
+
+	// with timeshift, the frames take a detour
+	eti_timeshift = NULL;
+	if(options.timeshift_minutes) {
+		eti_timeshift = new ETITimeshift(this, options.timeshift_minutes * 60 * 1000 / 24);
+		if(!eti_timeshift->Open()) {
+			delete eti_timeshift;
+			eti_timeshift = NULL;
+		}
+	}
 
 	if(!options.dab_live_source_binary.empty()) {
 		eti_source = NULL;
 	} else {
-		eti_source = new ETISource(options.filename, this);
+		if(ETICaptureSource::IsCaptureFile(options.filename))
+			eti_source = new ETICaptureSource(options.filename, this);
+		else if(EDISource::IsEDIAddress(options.filename))
+			eti_source = new EDISource(options.filename, GetSourceObserver());
+		else if(ETINetworkSource::IsNetworkAddress(options.filename))
+			eti_source = new ETINetworkSource(options.filename, GetSourceObserver());
+		else
+			eti_source = new ETISource(options.filename, GetSourceObserver());
+		eti_source->SetTail(options.tail);
 		eti_source_thread = std::thread(&ETISource::Main, eti_source);
 	}
 
@@ -207,6 +257,7 @@ DABlinGTK::~DABlinGTK() {
 		delete eti_source;
 	}
 
+	delete eti_timeshift;
 	delete eti_player;
 
 	delete pad_decoder;
@@ -303,6 +354,29 @@ void DABlinGTK::InitWidgets() {
 	label_dl.set_padding(WIDGET_SPACE, WIDGET_SPACE);
 
 	progress_position.set_show_text();
+	box_timeshift.set_spacing(WIDGET_SPACE);
+	box_timeshift.set_halign(Gtk::ALIGN_CENTER);
+	box_timeshift.add(btn_timeshift_back);
+	box_timeshift.add(tglbtn_timeshift_pause);
+	box_timeshift.add(btn_timeshift_forward);
+	box_timeshift.add(btn_timeshift_live);
+
+	btn_timeshift_back.set_label("-" + std::to_string(timeshift_skip_seconds) + "s");
+	btn_timeshift_back.set_tooltip_text("Timeshift: back (b)");
+	btn_timeshift_back.signal_clicked().connect(sigc::mem_fun(*this, &DABlinGTK::on_btn_timeshift_back));
+	tglbtn_timeshift_pause.set_label("Pause");
+	tglbtn_timeshift_pause.set_tooltip_text("Timeshift: pause/resume (p)");
+	tglbtn_timeshift_pause.signal_clicked().connect(sigc::mem_fun(*this, &DABlinGTK::on_tglbtn_timeshift_pause));
+	btn_timeshift_forward.set_label("+" + std::to_string(timeshift_skip_seconds) + "s");
+	btn_timeshift_forward.set_tooltip_text("Timeshift: forward (f)");
+	btn_timeshift_forward.signal_clicked().connect(sigc::mem_fun(*this, &DABlinGTK::on_btn_timeshift_forward));
+	btn_timeshift_live.set_label("Live");
+	btn_timeshift_live.set_tooltip_text("Timeshift: catch up to live (l)");
+	btn_timeshift_live.signal_clicked().connect(sigc::mem_fun(*this, &DABlinGTK::on_btn_timeshift_live));
+	progress_position.set_tooltip_text("Click to seek");
+	eventbox_progress_position.add(progress_position);
+	eventbox_progress_position.set_events(Gdk::BUTTON_PRESS_MASK);
+	eventbox_progress_position.signal_button_press_event().connect(sigc::mem_fun(*this, &DABlinGTK::on_progress_position_button_press));
 
 
 	top_grid.set_column_spacing(WIDGET_SPACE);
@@ -320,10 +394,13 @@ void DABlinGTK::InitWidgets() {
 	top_grid.attach_next_to(vlmbtn, tglbtn_mute, Gtk::POS_RIGHT, 1, 1);
 	top_grid.attach_next_to(tglbtn_slideshow, tglbtn_mute, Gtk::POS_BOTTOM, 2, 1);
 	top_grid.attach_next_to(frame_label_dl, frame_combo_channels, Gtk::POS_BOTTOM, 6, 1);
-	top_grid.attach_next_to(progress_position, frame_label_dl, Gtk::POS_BOTTOM, 6, 1);
+	top_grid.attach_next_to(eventbox_progress_position, frame_label_dl, Gtk::POS_BOTTOM, 6, 1);
+	top_grid.attach_next_to(box_timeshift, eventbox_progress_position, Gtk::POS_BOTTOM, 6, 1);
 
 	show_all_children();
 	progress_position.hide();	// invisible until progress updated
+	if(!eti_timeshift)
+		box_timeshift.hide();
 }
 
 void DABlinGTK::AddChannels() {
@@ -451,6 +528,28 @@ bool DABlinGTK::HandleKeyPressEvent(GdkEventKey* key_event) {
 			tglbtn_mute.clicked();
 			return true;
 		}
+
+		// timeshift control
+		if(eti_timeshift) {
+			switch(key_event->keyval) {
+			case GDK_KEY_p:
+			case GDK_KEY_P:
+				tglbtn_timeshift_pause.clicked();
+				return true;
+			case GDK_KEY_b:
+			case GDK_KEY_B:
+				on_btn_timeshift_back();
+				return true;
+			case GDK_KEY_f:
+			case GDK_KEY_F:
+				on_btn_timeshift_forward();
+				return true;
+			case GDK_KEY_l:
+			case GDK_KEY_L:
+				on_btn_timeshift_live();
+				return true;
+			}
+		}
 	}
 	return false;
 }
@@ -462,10 +561,38 @@ void DABlinGTK::ETIUpdateProgressEmitted() {
 
 	progress_position.set_fraction(progress.value);
 	progress_position.set_text(progress.text);
+	progress_frames_total = progress.frames_total;
 	if(!progress_position.get_visible())
 		progress_position.show();
 }
 
+void DABlinGTK::on_tglbtn_timeshift_pause() {
+	eti_timeshift->Pause(tglbtn_timeshift_pause.get_active());
+}
+
+void DABlinGTK::on_btn_timeshift_live() {
+	// catching up also ends the pause
+	eti_timeshift->CatchUp();
+	if(tglbtn_timeshift_pause.get_active())
+		tglbtn_timeshift_pause.clicked();
+}
+
+bool DABlinGTK::on_progress_position_button_press(GdkEventButton* button_event) {
+	if(button_event->button != 1 || !(eti_source || eti_timeshift) || !progress_frames_total)
+		return false;
+
+	// seek to the clicked position
+	int width = eventbox_progress_position.get_allocated_width();
+	if(width <= 0)
+		return false;
+	double fraction = std::max(0.0, std::min(1.0, button_event->x / width));
+	if(eti_timeshift)
+		eti_timeshift->Seek(fraction * progress_frames_total);
+	else
+		eti_source->Seek(fraction * progress_frames_total);
+	return true;
+}
+
 void DABlinGTK::ETIChangeFormatEmitted() {
 //	fprintf(stderr, "### ETIChangeFormatEmitted\n");
 
@@ -551,8 +678,12 @@ void DABlinGTK::on_combo_channels() {
 		options.initial_scids = LISTED_SERVICE::scids_none;
 	}
 
+	// the timeshift of the previous channel is obsolete
+	if(eti_timeshift)
+		eti_timeshift->Reset();
+
 	// append
-	eti_source = new DABLiveETISource(options.dab_live_source_binary, channel, this);
+	eti_source = new DABLiveETISource(options.dab_live_source_binary, channel, GetSourceObserver());
 	eti_source_thread = std::thread(&ETISource::Main, eti_source);
 }
 
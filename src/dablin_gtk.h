@@ -29,6 +29,10 @@
 #include <gtkmm.h>
 
 #include "eti_source.h"
+#include "eti_capture.h"
+#include "edi_source.h"
+#include "eti_network_source.h"
+#include "eti_timeshift.h"
 #include "eti_player.h"
 #include "fic_decoder.h"
 #include "pad_decoder.h"
@@ -92,6 +96,8 @@ struct DABlinGTKOptions {
 	int gain;
 	bool initially_disable_slideshow;
 	bool loose;
+	bool tail;
+	int timeshift_minutes;
 	
 DABlinGTKOptions() :
 	initial_sid(LISTED_SERVICE::sid_none),
@@ -99,7 +105,9 @@ DABlinGTKOptions() :
 	pcm_output(false),
 	gain(DAB_LIVE_SOURCE_CHANNEL::auto_gain),
 	initially_disable_slideshow(false),
-	loose(false)
+	loose(false),
+	tail(false),
+	timeshift_minutes(0)
 	{}
 };
 
@@ -144,6 +152,8 @@ private:
 
 	ETISource *eti_source;
 	std::thread eti_source_thread;
+	ETITimeshift *eti_timeshift;
+	ETISourceObserver* GetSourceObserver() {return eti_timeshift ? (ETISourceObserver*) eti_timeshift : this;}
 
 	ETIPlayer *eti_player;
 
@@ -155,6 +165,7 @@ private:
 	void ETIProcessFrame(const uint8_t *data) {eti_player->ProcessFrame(data);};
 	void ETIUpdateProgress(const ETI_PROGRESS progress) {eti_update_progress.PushAndEmit(progress);};
 	void ETIUpdateProgressEmitted();
+	void ETIRestoreFIC(const uint8_t *data, size_t len) {fic_decoder->Process(data, len);}
 
 	GTKDispatcherQueue<std::string> eti_change_format;
 	void ETIChangeFormat(const std::string& format) {eti_change_format.PushAndEmit(format);}
@@ -193,7 +204,17 @@ private:
 	Gtk::Frame frame_label_dl;
 	Gtk::Label label_dl;
 
+	Gtk::EventBox eventbox_progress_position;
 	Gtk::ProgressBar progress_position;
+	size_t progress_frames_total;
+
+	Gtk::Box box_timeshift;
+	Gtk::ToggleButton tglbtn_timeshift_pause;
+	Gtk::Button btn_timeshift_back;
+	Gtk::Button btn_timeshift_forward;
+	Gtk::Button btn_timeshift_live;
+
+	static const int timeshift_skip_seconds = 10;
 
 
 	void InitWidgets();
@@ -207,6 +228,11 @@ private:
 	void on_tglbtn_slideshow();
 	void on_combo_channels();
 	void on_combo_services();
+	bool on_progress_position_button_press(GdkEventButton* button_event);
+	void on_tglbtn_timeshift_pause();
+	void on_btn_timeshift_back() {eti_timeshift->Skip(-timeshift_skip_seconds);}
+	void on_btn_timeshift_forward() {eti_timeshift->Skip(timeshift_skip_seconds);}
+	void on_btn_timeshift_live();
 
 	void ConnectKeyPressEventHandler(Gtk::Widget& widget);
 	bool HandleKeyPressEvent(GdkEventKey* key_event);
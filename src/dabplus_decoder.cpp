@@ -20,15 +20,21 @@
 
 
 // --- SuperframeFilter -----------------------------------------------------------------
-SuperframeFilter::SuperframeFilter(SubchannelSinkObserver* observer) : SubchannelSink(observer) {
+SuperframeFilter::SuperframeFilter(SubchannelSinkObserver* observer, PASSTHROUGH_FORMAT passthrough_format) : SubchannelSink(observer) {
 	aac_dec = NULL;
+	this->passthrough_format = passthrough_format;
+	aac_passthrough = NULL;
 
 	frame_len = 0;
 	frame_count = 0;
+	ring_start = 0;
 	sync_frames = 0;
+	sync_phase_known = false;
+	sync_phase_failures = 0;
 
-	sf_raw = NULL;
-	sf = NULL;
+	// allocate for the max. sub-channel size, so that a size change needs no new buffers
+	sf_raw = new uint8_t[5 * frame_len_max];
+	sf = new uint8_t[5 * frame_len_max];
 	sf_len = 0;
 
 	sf_format_set = false;
@@ -41,71 +47,92 @@ SuperframeFilter::~SuperframeFilter() {
 	delete[] sf_raw;
 	delete[] sf;
 	delete aac_dec;
+	delete aac_passthrough;
 }
 
 void SuperframeFilter::Feed(const uint8_t *data, size_t len) {
-
-	//cyang add for test
-//	fprintf(stderr, "SuperframeFilter: Feed... len = %d\n",len);
-
-	uint16_t f_len = (uint16_t)len;
-	uint8_t format_header[4];
-	format_header[0] = 0xff;
-	format_header[1] = 0xff;
-	format_header[2] = (uint8_t)(f_len>>8);
-	format_header[3] = (uint8_t)f_len;
-	fwrite(format_header, 4, 1, stdout);
-	fwrite(data, len, 1, stdout);
-
 	// check frame len
-	if(frame_len) {
-		if(frame_len != len) {
-			fprintf(stderr, "SuperframeFilter: different frame len %zu (should be: %zu) - frame ignored!\n", len, frame_len);
-			return;
-		}
-	} else {
+	if(frame_len != len) {
 		if(len < 10) {
 			fprintf(stderr, "SuperframeFilter: frame len %zu too short - frame ignored!\n", len);
 			return;
 		}
+		if(len > frame_len_max) {
+			fprintf(stderr, "SuperframeFilter: frame len %zu too long - frame ignored!\n", len);
+			return;
+		}
 		if((5 * len) % 120) {
 			fprintf(stderr, "SuperframeFilter: resulting Superframe len of len %zu not divisible by 120 - frame ignored!\n", len);
 			return;
 		}
 
+		if(frame_len)
+			fprintf(stderr, "SuperframeFilter: frame len changed to %zu (was: %zu) - Superframe sync reset!\n", len, frame_len);
+
 		frame_len = len;
 		sf_len = 5 * frame_len;
 
-		sf_raw = new uint8_t[sf_len];
-		sf = new uint8_t[sf_len];
+		frame_count = 0;
+		ring_start = 0;
+		sync_phase_known = false;
+		sync_phase_failures = 0;
+		sf_format_set = false;
 	}
 
-	if(frame_count == 5) {
-		// shift previous frames
-		for(int i = 0; i < 4; i++)
-			memcpy(sf_raw + i * frame_len, sf_raw + (i + 1) * frame_len, frame_len);
-	} else {
+	if(sync_phase_known) {
+		// assemble the Superframe directly
+		memcpy(sf + frame_count * frame_len, data, frame_len);
 		frame_count++;
+	} else {
+		// keep the last five frames in a ring (the oldest one at ring_start)
+		int slot;
+		if(frame_count == 5) {
+			slot = ring_start;
+			ring_start = (ring_start + 1) % 5;
+		} else {
+			slot = (ring_start + frame_count) % 5;
+			frame_count++;
+		}
+		memcpy(sf_raw + slot * frame_len, data, frame_len);
 	}
 
-	// copy frame
-	memcpy(sf_raw + (frame_count - 1) * frame_len, data, frame_len);
-
 	if(frame_count < 5)
 		return;
 
 
-	// append RS coding on copy
-	memcpy(sf, sf_raw, sf_len);
-	rs_dec.DecodeSuperframe(sf, sf_len);
+	// while searching the Superframe start, check the Fire code on the raw
+	// frames first (the header is within the oldest frame) - only if that
+	// fails, the RS coding is (at first) applied to the codewords covering the
+	// header
+	bool header_decoded = false;
+	if(!sync_phase_known) {
+		bool fire_code_ok = CheckFireCode(sf_raw + ring_start * frame_len);
+
+		// append RS coding on (linearised) copy
+		for(int i = 0; i < 5; i++)
+			memcpy(sf + i * frame_len, sf_raw + ((ring_start + i) % 5) * frame_len, frame_len);
+
+		if(!fire_code_ok) {
+			rs_dec.DecodeSuperframeHeader(sf, sf_len, 11);
+			header_decoded = true;
+
+			if(!CheckFireCode(sf)) {
+				SyncFailed();
+				return;
+			}
+		}
+	}
+
+	rs_dec.DecodeSuperframe(sf, sf_len, header_decoded);
 
 	if(!CheckSync()) {
-		if(sync_frames == 0)
-			fprintf(stderr, "SuperframeFilter: Superframe sync started...\n");
-		sync_frames++;
+		SyncFailed();
 		return;
 	}
 
+	sync_phase_known = true;
+	sync_phase_failures = 0;
+
 	if(sync_frames) {
 		fprintf(stderr, "SuperframeFilter: Superframe sync succeeded after %d frame(s)\n", sync_frames);
 		sync_frames = 0;
@@ -135,10 +162,16 @@ void SuperframeFilter::Feed(const uint8_t *data, size_t len) {
 		}
 
 		au_len -= 2;
-		aac_dec->DecodeFrame(au_data, au_len);
+		if(aac_passthrough)
+			aac_passthrough->PutAU(au_data, au_len);
+		else
+			aac_dec->DecodeFrame(au_data, au_len);
 		CheckForPAD(au_data, au_len);
 	}
 
+	if(aac_passthrough)
+		aac_passthrough->Flush();
+
 	// ensure getting a complete new Superframe
 	frame_count = 0;
 }
@@ -173,17 +206,35 @@ void SuperframeFilter::ResetPAD() {
 }
 
 
-bool SuperframeFilter::CheckSync() {
+void SuperframeFilter::SyncFailed() {
+	if(sync_frames == 0)
+		fprintf(stderr, "SuperframeFilter: Superframe sync started...\n");
+	sync_frames++;
+
+	// retry the known frame phase (e.g. on bad reception), before searching for a new one
+	if(sync_phase_known) {
+		frame_count = 0;
+		ring_start = 0;
+		if(++sync_phase_failures == sync_phase_max_failures)
+			sync_phase_known = false;
+	}
+}
+
+bool SuperframeFilter::CheckFireCode(const uint8_t *data) {
 	// abort, if au_start is kind of zero (prevent sync on complete zero array)
-	if(sf[3] == 0x00 && sf[4] == 0x00)
+	if(data[3] == 0x00 && data[4] == 0x00)
 		return false;
 
 	// TODO: use fire code for error correction
 
 	// try to sync on fire code
-	uint16_t crc_stored = sf[0] << 8 | sf[1];
-	uint16_t crc_calced = CalcCRC::CalcCRC_FIRE_CODE.Calc(sf + 2, 9);
-	if(crc_stored != crc_calced)
+	uint16_t crc_stored = data[0] << 8 | data[1];
+	uint16_t crc_calced = CalcCRC::CalcCRC_FIRE_CODE.Calc(data + 2, 9);
+	return crc_stored == crc_calced;
+}
+
+bool SuperframeFilter::CheckSync() {
+	if(!CheckFireCode(sf))
 		return false;
 
 
@@ -252,6 +303,13 @@ void SuperframeFilter::ProcessFormat() {
 	ss << "@ " << bitrate << " kBit/s";
 	observer->FormatChange(ss.str());
 
+	// output the AUs as they are, if desired
+	if(passthrough_format != PASSTHROUGH_NONE) {
+		delete aac_passthrough;
+		aac_passthrough = new AACPassthrough(observer, passthrough_format, sf_format, sf_len);
+		return;
+	}
+
 	if(aac_dec)
 		delete aac_dec;
 #ifdef DABLIN_AAC_FAAD2
@@ -265,46 +323,51 @@ void SuperframeFilter::ProcessFormat() {
 
 // --- RSDecoder -----------------------------------------------------------------
 RSDecoder::RSDecoder() {
-	rs_handle = init_rs_char(8, 0x11D, 0, 1, 10, 135);
-	if(!rs_handle)
-		throw std::runtime_error("RSDecoder: error while init_rs_char");
+	header_corr_count = 0;
+	header_uncorr_errors = false;
 }
 
-RSDecoder::~RSDecoder() {
-	free_rs_char(rs_handle);
+void RSDecoder::DecodeSuperframeHeader(uint8_t *sf, size_t sf_len, size_t header_len) {
+	int subch_index = sf_len / 120;
+
+	// the header bytes are the first bytes of the first codewords
+	int codewords = header_len < (size_t) subch_index ? header_len : subch_index;
+
+	header_corr_count = 0;
+	header_uncorr_errors = false;
+	for(int i = 0; i < codewords; i++) {
+		int corr_count = DABPlusRSCodec::Decode(sf + i, subch_index);
+		if(corr_count == -1)
+			header_uncorr_errors = true;
+		else
+			header_corr_count += corr_count;
+	}
 }
 
-void RSDecoder::DecodeSuperframe(uint8_t *sf, size_t sf_len) {
+void RSDecoder::DecodeSuperframe(uint8_t *sf, size_t sf_len, bool header_decoded) {
 //	// insert errors for test
 //	sf[0] ^= 0xFF;
 //	sf[10] ^= 0xFF;
 //	sf[20] ^= 0xFF;
 
 	int subch_index = sf_len / 120;
-	int total_corr_count = 0;
-	bool uncorr_errors = false;
-
-	// process all RS packets
-	for(int i = 0; i < subch_index; i++) {
-		for(int pos = 0; pos < 120; pos++)
-			rs_packet[pos] = sf[pos * subch_index + i];
-
-		// detect errors
-		int corr_count = decode_rs_char(rs_handle, rs_packet, corr_pos, 0);
-		if(corr_count == -1)
-			uncorr_errors = true;
-		else
-			total_corr_count += corr_count;
-
-		// correct errors
-		for(int j = 0; j < corr_count; j++) {
-
-			int pos = corr_pos[j] - 135;
-			if(pos < 0)
+	int total_corr_count = header_decoded ? header_corr_count : 0;
+	bool uncorr_errors = header_decoded ? header_uncorr_errors : false;
+
+	// usually all codewords are error-free
+	if(syndrome_calc.Calc(sf, subch_index)) {
+		// process all RS packets with errors
+		for(int i = 0; i < subch_index; i++) {
+			if(!syndrome_calc.IsCodewordDirty(i))
 				continue;
 
-//			fprintf(stderr, "j: %d, pos: %d, sf-index: %d\n", j, pos, pos * subch_index + i);
-			sf[pos * subch_index + i] = rs_packet[pos];
+			// correct errors (in place, i.e. without deinterleaving)
+			syndrome_calc.GetSyndromes(i, syndromes);
+			int corr_count = DABPlusRSCodec::Correct(sf + i, subch_index, syndromes);
+			if(corr_count == -1)
+				uncorr_errors = true;
+			else
+				total_corr_count += corr_count;
 		}
 	}
 
@@ -315,6 +378,137 @@ void RSDecoder::DecodeSuperframe(uint8_t *sf, size_t sf_len) {
 
 
 
+// --- AACPassthrough -----------------------------------------------------------------
+AACPassthrough::AACPassthrough(SubchannelSinkObserver* observer, PASSTHROUGH_FORMAT format, SuperframeFormat sf_format, size_t sf_len) {
+	this->observer = observer;
+	this->format = format;
+	this->sf_format = sf_format;
+
+	fprintf(stderr, "AACPassthrough: using format '%s'\n", format == PASSTHROUGH_ADTS ? "ADTS" : "LATM/LOAS");
+	if(format == PASSTHROUGH_ADTS)
+		fprintf(stderr, "AACPassthrough: ADTS cannot signal the 960 transform used by DAB+ - LATM/LOAS can\n");
+
+	// all AUs plus their headers (including the LATM payload length info)
+	output_capacity = sf_len + 6 * (32 + sf_len / 255);
+	output = new uint8_t[output_capacity];
+	output_len = 0;
+	config_pending = true;
+}
+
+AACPassthrough::~AACPassthrough() {
+	delete[] output;
+}
+
+void AACPassthrough::PutAU(const uint8_t *data, size_t len) {
+	if(format == PASSTHROUGH_ADTS) {
+		AddADTSFrame(data, len);
+	} else {
+		// config once per Superframe - with the first AU actually output
+		AddLATMFrame(data, len, config_pending);
+		config_pending = false;
+	}
+}
+
+void AACPassthrough::Flush() {
+	if(output_len)
+		observer->PutAudio(output, output_len);
+	output_len = 0;
+	config_pending = true;
+}
+
+void AACPassthrough::AddADTSFrame(const uint8_t *data, size_t len) {
+	size_t frame_len = 7 + len;
+	if(frame_len > 0x1FFF) {
+		fprintf(stderr, "AACPassthrough: AU len %zu too long for ADTS - AU ignored!\n", len);
+		return;
+	}
+
+	/* ADTS header (without CRC)
+	 *
+	 * The core sample rate is signalled (implicit SBR/PS signalling), as with
+	 * ADTS an explicit signalling is not possible.
+	 */
+	BitWriter writer(output + output_len, output_capacity - output_len);
+	writer.AddBits(0xFFF, 12);							// syncword
+	writer.AddBits(0, 1);								// ID: MPEG-4
+	writer.AddBits(0, 2);								// layer
+	writer.AddBits(1, 1);								// protection_absent
+	writer.AddBits(2 - 1, 2);							// profile: AAC LC
+	writer.AddBits(sf_format.GetCoreSrIndex(), 4);		// sampling_frequency_index
+	writer.AddBits(0, 1);								// private_bit
+	writer.AddBits(sf_format.GetCoreChConfig(), 3);		// channel_configuration
+	writer.AddBits(0, 4);								// original_copy, home, copyright_identification_bit/start
+	writer.AddBits(frame_len, 13);						// aac_frame_length
+	writer.AddBits(0x7FF, 11);							// adts_buffer_fullness: VBR
+	writer.AddBits(0, 2);								// number_of_raw_data_blocks_in_frame
+	writer.AddBytes(data, len);
+
+	output_len += writer.GetByteLen();
+}
+
+void AACPassthrough::AddAudioSpecificConfig(BitWriter& writer) {
+	// same explicit (backwards-compatible) signalling as for the decoders
+	writer.AddBits(2, 5);								// AAC LC
+	writer.AddBits(sf_format.GetCoreSrIndex(), 4);
+	writer.AddBits(sf_format.GetCoreChConfig(), 4);
+	writer.AddBits(0b100, 3);							// GASpecificConfig with 960 transform
+
+	if(sf_format.sbr_flag) {
+		writer.AddBits(0x2B7, 11);						// sync extension for SBR
+		writer.AddBits(5, 5);							// SBR
+		writer.AddBits(1, 1);							// SBR present
+		writer.AddBits(sf_format.GetExtensionSrIndex(), 4);
+
+		if(sf_format.ps_flag) {
+			writer.AddBits(0x548, 11);					// sync extension for PS
+			writer.AddBits(1, 1);						// PS present
+		}
+	}
+}
+
+void AACPassthrough::AddLATMFrame(const uint8_t *data, size_t len, bool add_config) {
+	// AudioSyncStream header (the AudioMuxElement len is filled in afterwards)
+	uint8_t *frame = output + output_len;
+	BitWriter writer(frame, output_capacity - output_len);
+	writer.AddBits(0x2B7, 11);
+	writer.AddBits(0, 13);
+
+	// AudioMuxElement
+	writer.AddBits(add_config ? 0 : 1, 1);				// useSameStreamMux
+	if(add_config) {
+		// StreamMuxConfig
+		writer.AddBits(0, 1);							// audioMuxVersion
+		writer.AddBits(1, 1);							// allStreamsSameTimeFraming
+		writer.AddBits(0, 6);							// numSubFrames
+		writer.AddBits(0, 4);							// numProgram
+		writer.AddBits(0, 3);							// numLayer
+		AddAudioSpecificConfig(writer);
+		writer.AddBits(0, 3);							// frameLengthType: variable
+		writer.AddBits(0xFF, 8);						// latmBufferFullness
+		writer.AddBits(0, 1);							// otherDataPresent
+		writer.AddBits(0, 1);							// crcCheckPresent
+	}
+
+	// PayloadLengthInfo + PayloadMux
+	for(size_t i = 0; i < len / 255; i++)
+		writer.AddBits(0xFF, 8);
+	writer.AddBits(len % 255, 8);
+	writer.AddBytes(data, len);
+	writer.AlignToByte();
+
+	size_t mux_len = writer.GetByteLen() - 3;
+	if(mux_len > 0x1FFF) {
+		fprintf(stderr, "AACPassthrough: AU len %zu too long for LATM/LOAS - AU ignored!\n", len);
+		return;
+	}
+	frame[1] |= mux_len >> 8;
+	frame[2] = mux_len & 0xFF;
+
+	output_len += writer.GetByteLen();
+}
+
+
+
 // --- AACDecoder -----------------------------------------------------------------
 AACDecoder::AACDecoder(std::string decoder_name, SubchannelSinkObserver* observer, SuperframeFormat sf_format) {
 	fprintf(stderr, "AACDecoder: using decoder '%s'\n", decoder_name.c_str());
@@ -38,10 +38,7 @@
 #include <fdk-aac/aacdecoder_lib.h>
 #endif
 
-extern "C" {
-#include <fec.h>
-}
-
+#include "dabplus_rs.h"
 #include "subchannel_sink.h"
 #include "tools.h"
 
@@ -93,14 +90,16 @@ typedef struct adts_variable_header
 // --- RSDecoder -----------------------------------------------------------------
 class RSDecoder {
 private:
-	void *rs_handle;
-	uint8_t rs_packet[120];
-	int corr_pos[10];
+	RSSyndromeCalculator syndrome_calc;
+	uint8_t syndromes[RSSyndromeCalculator::nroots];
+
+	int header_corr_count;
+	bool header_uncorr_errors;
 public:
 	RSDecoder();
-	~RSDecoder();
 
-	void DecodeSuperframe(uint8_t *sf, size_t sf_len);
+	void DecodeSuperframeHeader(uint8_t *sf, size_t sf_len, size_t header_len);
+	void DecodeSuperframe(uint8_t *sf, size_t sf_len, bool header_decoded = false);
 };
 
 
@@ -151,15 +150,49 @@ public:
 #endif
 
 
+// --- AACPassthrough -----------------------------------------------------------------
+// Outputs the AUs as ADTS or LATM/LOAS frames (instead of decoding them); the
+// frames of a Superframe are collected and then output at once.
+class AACPassthrough {
+private:
+	SubchannelSinkObserver* observer;
+	PASSTHROUGH_FORMAT format;
+	SuperframeFormat sf_format;
+
+	uint8_t *output;
+	size_t output_capacity;
+	size_t output_len;
+	bool config_pending;
+
+	void AddADTSFrame(const uint8_t *data, size_t len);
+	void AddLATMFrame(const uint8_t *data, size_t len, bool add_config);
+	void AddAudioSpecificConfig(BitWriter& writer);
+public:
+	AACPassthrough(SubchannelSinkObserver* observer, PASSTHROUGH_FORMAT format, SuperframeFormat sf_format, size_t sf_len);
+	~AACPassthrough();
+
+	void PutAU(const uint8_t *data, size_t len);
+	void Flush();
+};
+
+
 // --- SuperframeFilter -----------------------------------------------------------------
 class SuperframeFilter : public SubchannelSink {
 private:
 	RSDecoder rs_dec;
 	AACDecoder *aac_dec;
+	PASSTHROUGH_FORMAT passthrough_format;
+	AACPassthrough *aac_passthrough;
+
+	static const size_t frame_len_max = 1023 * 8;	// max. sub-channel size
 
 	size_t frame_len;
 	int frame_count;
+	int ring_start;
 	int sync_frames;
+	bool sync_phase_known;
+	int sync_phase_failures;
+	static const int sync_phase_max_failures = 2;
 
 	uint8_t *sf_raw;
 	uint8_t *sf;
@@ -172,12 +205,14 @@ private:
 	int num_aus;
 	int au_start[6+1]; // +1 for end of last AU
 
+	void SyncFailed();
+	bool CheckFireCode(const uint8_t *data);
 	bool CheckSync();
 	void ProcessFormat();
 	void CheckForPAD(const uint8_t *data, size_t len);
 	void ResetPAD();
 public:
-	SuperframeFilter(SubchannelSinkObserver* observer);
+	SuperframeFilter(SubchannelSinkObserver* observer, PASSTHROUGH_FORMAT passthrough_format = PASSTHROUGH_NONE);
 	~SuperframeFilter();
 
 	void Feed(const uint8_t *data, size_t len);
@@ -0,0 +1,219 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dabplus_rs.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define RSSYNDROME_SIMD
+#include <immintrin.h>
+#endif
+
+
+// --- RSSyndromeCalculator -----------------------------------------------------------------
+// products of all low/high nibbles with the generator polynomial roots alpha^j
+// (16 entries per root), generated at compile time
+struct RSNibbleMulLoGen {
+	static constexpr int len = RSSyndromeCalculator::nroots * 16;
+	static constexpr uint8_t Value(int i) {return DABPlusRSCodec::GFMul(i % 16, DABPlusRSCodec::Alpha(i / 16));}
+};
+struct RSNibbleMulHiGen {
+	static constexpr int len = RSSyndromeCalculator::nroots * 16;
+	static constexpr uint8_t Value(int i) {return DABPlusRSCodec::GFMul((i % 16) << 4, DABPlusRSCodec::Alpha(i / 16));}
+};
+typedef RSTable<RSNibbleMulLoGen> RSNibbleMulLo;
+typedef RSTable<RSNibbleMulHiGen> RSNibbleMulHi;
+
+
+RSSyndromeCalculator::RSSyndromeCalculator() {
+	backend = DetectBackend();
+	codewords = 0;
+
+	memset(syndromes, 0x00, sizeof(syndromes));
+}
+
+RSSyndromeCalculator::Backend RSSyndromeCalculator::DetectBackend() {
+	// detect only once
+	static const Backend detected_backend = []() -> Backend {
+#ifdef RSSYNDROME_SIMD
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			return BACKEND_AVX2;
+		if(__builtin_cpu_supports("ssse3"))
+			return BACKEND_SSSE3;
+#endif
+		return BACKEND_SCALAR;
+	}();
+	return detected_backend;
+}
+
+const char* RSSyndromeCalculator::GetBackendName(Backend backend) {
+	switch(backend) {
+	case BACKEND_SSSE3:
+		return "SSSE3";
+	case BACKEND_AVX2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
+
+bool RSSyndromeCalculator::Calc(const uint8_t *sf, int codewords) {
+	this->codewords = codewords;
+
+	switch(backend) {
+#ifdef RSSYNDROME_SIMD
+	case BACKEND_SSSE3:
+		return CalcSSSE3(sf);
+	case BACKEND_AVX2:
+		return CalcAVX2(sf);
+#endif
+	default:
+		return CalcScalar(sf, 0);
+	}
+}
+
+bool RSSyndromeCalculator::IsCodewordDirty(int codeword) const {
+	for(int j = 0; j < nroots; j++)
+		if(syndromes[j][codeword])
+			return true;
+	return false;
+}
+
+void RSSyndromeCalculator::GetSyndromes(int codeword, uint8_t *codeword_syndromes) const {
+	for(int j = 0; j < nroots; j++)
+		codeword_syndromes[j] = syndromes[j][codeword];
+}
+
+bool RSSyndromeCalculator::CalcScalar(const uint8_t *sf, int first_codeword) {
+	bool dirty = false;
+
+	for(int i = first_codeword; i < codewords; i++) {
+		uint8_t s[nroots];
+		if(DABPlusRSCodec::CalcSyndromes(sf + i, codewords, s))
+			dirty = true;
+
+		for(int j = 0; j < nroots; j++)
+			syndromes[j][i] = s[j];
+	}
+	return dirty;
+}
+
+#ifdef RSSYNDROME_SIMD
+__attribute__((target("ssse3")))
+bool RSSyndromeCalculator::CalcSSSE3(const uint8_t *sf) {
+	const size_t sf_len = codewords * nn;
+	const __m128i mask = _mm_set1_epi8(0x0F);
+
+	__m128i lo[nroots];
+	__m128i hi[nroots];
+	for(int j = 0; j < nroots; j++) {
+		lo[j] = _mm_loadu_si128((const __m128i*) (RSNibbleMulLo::values + 16 * j));
+		hi[j] = _mm_loadu_si128((const __m128i*) (RSNibbleMulHi::values + 16 * j));
+	}
+
+	// 16 codewords at once
+	for(int first = 0; first < codewords; first += 16) {
+		__m128i s[nroots];
+		for(int j = 0; j < nroots; j++)
+			s[j] = _mm_setzero_si128();
+
+		for(int pos = 0; pos < nn; pos++) {
+			size_t offset = pos * codewords + first;
+			__m128i r;
+			if(offset + 16 <= sf_len) {
+				r = _mm_loadu_si128((const __m128i*) (sf + offset));
+			} else {
+				// don't read beyond the Superframe end
+				uint8_t r_bytes[16] = {0};
+				memcpy(r_bytes, sf + offset, sf_len - offset);
+				r = _mm_loadu_si128((const __m128i*) r_bytes);
+			}
+
+			s[0] = _mm_xor_si128(s[0], r);
+			for(int j = 1; j < nroots; j++) {
+				__m128i s_lo = _mm_shuffle_epi8(lo[j], _mm_and_si128(s[j], mask));
+				__m128i s_hi = _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(s[j], 4), mask));
+				s[j] = _mm_xor_si128(_mm_xor_si128(s_lo, s_hi), r);
+			}
+		}
+
+		// surplus lanes are stored as well, but ignored afterwards
+		for(int j = 0; j < nroots; j++)
+			_mm_storeu_si128((__m128i*) (syndromes[j] + first), s[j]);
+	}
+
+	bool dirty = false;
+	for(int j = 0; j < nroots; j++)
+		for(int i = 0; i < codewords; i++)
+			dirty |= syndromes[j][i] != 0;
+	return dirty;
+}
+
+__attribute__((target("avx2")))
+bool RSSyndromeCalculator::CalcAVX2(const uint8_t *sf) {
+	const size_t sf_len = codewords * nn;
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+
+	__m256i lo[nroots];
+	__m256i hi[nroots];
+	for(int j = 0; j < nroots; j++) {
+		lo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (RSNibbleMulLo::values + 16 * j)));
+		hi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) (RSNibbleMulHi::values + 16 * j)));
+	}
+
+	// 32 codewords at once
+	for(int first = 0; first < codewords; first += 32) {
+		__m256i s[nroots];
+		for(int j = 0; j < nroots; j++)
+			s[j] = _mm256_setzero_si256();
+
+		for(int pos = 0; pos < nn; pos++) {
+			size_t offset = pos * codewords + first;
+			__m256i r;
+			if(offset + 32 <= sf_len) {
+				r = _mm256_loadu_si256((const __m256i*) (sf + offset));
+			} else {
+				// don't read beyond the Superframe end
+				uint8_t r_bytes[32] = {0};
+				memcpy(r_bytes, sf + offset, sf_len - offset);
+				r = _mm256_loadu_si256((const __m256i*) r_bytes);
+			}
+
+			s[0] = _mm256_xor_si256(s[0], r);
+			for(int j = 1; j < nroots; j++) {
+				__m256i s_lo = _mm256_shuffle_epi8(lo[j], _mm256_and_si256(s[j], mask));
+				__m256i s_hi = _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(s[j], 4), mask));
+				s[j] = _mm256_xor_si256(_mm256_xor_si256(s_lo, s_hi), r);
+			}
+		}
+
+		// surplus lanes are stored as well, but ignored afterwards
+		for(int j = 0; j < nroots; j++)
+			_mm256_storeu_si256((__m256i*) (syndromes[j] + first), s[j]);
+	}
+
+	bool dirty = false;
+	for(int j = 0; j < nroots; j++)
+		for(int i = 0; i < codewords; i++)
+			dirty |= syndromes[j][i] != 0;
+	return dirty;
+}
+#endif
+
@@ -0,0 +1,76 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DABPLUS_RS_H_
+#define DABPLUS_RS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rs_codec.h"
+
+
+// RS(120,110) code of DAB+ (shortened from RS(255,245))
+typedef RSCodec<8, 0x11D, 0, 10, 135> DABPlusRSCodec;
+
+
+// --- RSSyndromeCalculator -----------------------------------------------------------------
+// Calculates the syndromes of all (shortened) RS(120,110) codewords of a
+// DAB+ Superframe at once. As the codewords are interleaved byte-wise, the
+// n-th bytes of all codewords are adjacent and can be processed in parallel
+// (using GF(2^8) multiplication by a constant via nibble tables).
+// The tables are shared by all instances, so that an instance just holds the
+// calculated syndromes.
+class RSSyndromeCalculator {
+public:
+	enum Backend {
+		BACKEND_SCALAR,
+		BACKEND_SSSE3,
+		BACKEND_AVX2
+	};
+
+	static const int nn = DABPlusRSCodec::len;
+	static const int nroots = DABPlusRSCodec::nroots;
+	static const int max_codewords = 352;	// enough for the max. sub-channel size
+private:
+	Backend backend;
+
+	uint8_t syndromes[nroots][max_codewords];
+	int codewords;
+
+	static Backend DetectBackend();
+
+	bool CalcScalar(const uint8_t *sf, int first_codeword);
+	bool CalcSSSE3(const uint8_t *sf);
+	bool CalcAVX2(const uint8_t *sf);
+public:
+	RSSyndromeCalculator();
+
+	void SetBackend(Backend backend) {this->backend = backend;}
+	Backend GetBackend() const {return backend;}
+	static const char* GetBackendName(Backend backend);
+
+	bool Calc(const uint8_t *sf, int codewords);
+	bool IsCodewordDirty(int codeword) const;
+	uint8_t GetSyndrome(int codeword, int root) const {return syndromes[root][codeword];}
+	void GetSyndromes(int codeword, uint8_t *codeword_syndromes) const;
+};
+
+
+
+#endif /* DABPLUS_RS_H_ */
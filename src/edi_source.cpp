@@ -0,0 +1,540 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "edi_source.h"
+
+
+// --- PFTDecoder -----------------------------------------------------------------
+PFTDecoder::PFTDecoder(PFTDecoderObserver *observer) {
+	this->observer = observer;
+
+	// RS(255,207) - shortened codewords are padded in front by the caller
+	rs_handle = init_rs_char(8, 0x11D, 0, 1, rs_nroots, 0);
+	if(!rs_handle)
+		fprintf(stderr, "PFTDecoder: error initializing RS decoder\n");
+
+	for(PFT_SLOT& slot : slots) {
+		slot.used = false;
+		slot.data.resize(max_packet_len);
+		slot.fragment_offsets.resize(max_fragments);
+		slot.fragment_lens.resize(max_fragments);
+	}
+	newest_pseq = 0;
+	newest_pseq_valid = false;
+	finished_count = 0;
+
+	packet.resize(max_packet_len);
+}
+
+PFTDecoder::~PFTDecoder() {
+	if(rs_handle)
+		free_rs_char(rs_handle);
+}
+
+size_t PFTDecoder::GetFragmentLen(const uint8_t *data, size_t len, bool& valid) {
+	valid = true;
+	if(len < header_min_len)
+		return 0;
+
+	bool fec = data[10] & 0x80;
+	bool addr = data[10] & 0x40;
+	size_t plen = (data[10] & 0x3F) << 8 | data[11];
+	size_t header_len = header_min_len + (fec ? 2 : 0) + (addr ? 4 : 0) + 2;
+	if(len < header_len)
+		return 0;
+
+	uint16_t hcrc_stored = data[header_len - 2] << 8 | data[header_len - 1];
+	uint16_t hcrc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(data, header_len - 2);
+	if(hcrc_stored != hcrc_calced) {
+		valid = false;
+		return 0;
+	}
+	return header_len + plen;
+}
+
+bool PFTDecoder::IsFinished(uint16_t pseq) {
+	const size_t len = sizeof(finished_pseqs) / sizeof(finished_pseqs[0]);
+	for(size_t i = 0; i < std::min(finished_count, len); i++)
+		if(finished_pseqs[i] == pseq)
+			return true;
+	return false;
+}
+
+PFT_SLOT* PFTDecoder::GetSlot(uint16_t pseq) {
+	PFT_SLOT *oldest = NULL;
+	for(PFT_SLOT& slot : slots) {
+		if(slot.used && slot.pseq == pseq)
+			return &slot;
+		if(!oldest || (oldest->used && (!slot.used || (uint16_t) (slot.pseq - oldest->pseq) >= 0x8000)))
+			oldest = &slot;
+	}
+
+	// if necessary, replace the oldest packet
+	if(oldest->used)
+		FinishSlot(*oldest);
+	return oldest;
+}
+
+void PFTDecoder::ProcessFragment(const uint8_t *data, size_t len) {
+	uint16_t pseq = data[2] << 8 | data[3];
+	size_t findex = data[4] << 16 | data[5] << 8 | data[6];
+	size_t fcount = data[7] << 16 | data[8] << 8 | data[9];
+	bool fec = data[10] & 0x80;
+	bool addr = data[10] & 0x40;
+	size_t plen = (data[10] & 0x3F) << 8 | data[11];
+	size_t rs_k = fec ? data[12] : 0;
+	size_t rs_z = fec ? data[13] : 0;
+	const uint8_t *payload = data + header_min_len + (fec ? 2 : 0) + (addr ? 4 : 0) + 2;
+	(void) len;
+
+	if(findex >= fcount || fcount > max_fragments || plen == 0 || (fec && (rs_k == 0 || rs_k + rs_nroots > rs_nn))) {
+		fprintf(stderr, "PFTDecoder: ignored invalid fragment %zu/%zu of packet %u\n", findex, fcount, pseq);
+		return;
+	}
+
+	// ignore late fragments of packets already passed on/dropped
+	if(IsFinished(pseq))
+		return;
+
+	if(newest_pseq_valid) {
+		uint16_t age = newest_pseq - pseq;
+		if(age >= 0x8000) {
+			newest_pseq = pseq;
+		} else if(age >= 0x100) {
+			// a huge jump back (e.g. the sender restarted)
+			for(PFT_SLOT& slot : slots)
+				slot.used = false;
+			finished_count = 0;
+			newest_pseq = pseq;
+		} else if(age >= max_delay_packets) {
+			return;
+		}
+	} else {
+		newest_pseq = pseq;
+		newest_pseq_valid = true;
+	}
+
+	// packets too old to complete are finished now
+	for(PFT_SLOT& slot : slots)
+		if(slot.used && slot.pseq != pseq && (uint16_t) (newest_pseq - slot.pseq) >= max_delay_packets)
+			FinishSlot(slot);
+
+	PFT_SLOT *slot = GetSlot(pseq);
+	if(!slot->used) {
+		slot->used = true;
+		slot->pseq = pseq;
+		slot->fcount = fcount;
+		slot->received = 0;
+		slot->fec = fec;
+		slot->rs_k = rs_k;
+		slot->rs_z = rs_z;
+		slot->plen = plen;
+		slot->data_used = 0;
+		std::fill(slot->fragment_lens.begin(), slot->fragment_lens.begin() + fcount, 0);
+	}
+
+	if(slot->fcount != fcount || slot->fec != fec || (fec && (slot->plen != plen || slot->rs_k != rs_k || slot->rs_z != rs_z))) {
+		fprintf(stderr, "PFTDecoder: ignored inconsistent fragment %zu/%zu of packet %u\n", findex, fcount, pseq);
+		return;
+	}
+	if(slot->fragment_lens[findex])
+		return;
+	if(slot->data_used + plen > max_packet_len) {
+		fprintf(stderr, "PFTDecoder: ignored fragment %zu/%zu exceeding packet %u\n", findex, fcount, pseq);
+		return;
+	}
+
+	memcpy(&slot->data[slot->data_used], payload, plen);
+	slot->fragment_offsets[findex] = slot->data_used;
+	slot->fragment_lens[findex] = plen;
+	slot->data_used += plen;
+	slot->received++;
+
+	if(slot->received == slot->fcount || (slot->fec && CanRecover(*slot)))
+		FinishSlot(*slot);
+}
+
+bool PFTDecoder::CanRecover(const PFT_SLOT& slot) {
+	/* Due to the interleaving, each fragment contains at most ceil(k / f)
+	 * data bytes and ceil(48 / f) parity bytes of every RS codeword.
+	 */
+	size_t missing = slot.fcount - slot.received;
+	size_t per_fragment = (slot.rs_k + slot.fcount - 1) / slot.fcount + (rs_nroots + slot.fcount - 1) / slot.fcount;
+	return missing * per_fragment <= rs_nroots;
+}
+
+bool PFTDecoder::Recover(const PFT_SLOT& slot, size_t& af_len) {
+	const size_t f = slot.fcount;
+	const size_t k = slot.rs_k;
+	const size_t rs_packet_len = f * slot.plen;
+	const size_t c = rs_packet_len / (k + rs_nroots);
+	if(!rs_handle || c == 0 || c * k < slot.rs_z || rs_packet_len > packet.size())
+		return false;
+
+	// de-interleave the fragments (missing ones are erasures)
+	for(size_t i = 0; i < f; i++) {
+		if(!slot.fragment_lens[i]) {
+			for(size_t j = 0; j < slot.plen; j++)
+				packet[j * f + i] = 0x00;
+			continue;
+		}
+		const uint8_t *fragment = &slot.data[slot.fragment_offsets[i]];
+		for(size_t j = 0; j < slot.plen; j++)
+			packet[j * f + i] = fragment[j];
+	}
+
+	// the RS packet consists of c data chunks (k bytes each), followed by their parity bytes
+	if(slot.received < f) {
+		const size_t pad = rs_nn - k - rs_nroots;
+		uint8_t codeword[rs_nn];
+		int eras_pos[rs_nroots];
+		memset(codeword, 0x00, pad);
+
+		for(size_t n = 0; n < c; n++) {
+			int eras_count = 0;
+			for(size_t b = 0; b < k + rs_nroots; b++) {
+				size_t pos = b < k ? n * k + b : c * k + n * rs_nroots + (b - k);
+				codeword[pad + b] = packet[pos];
+				if(!slot.fragment_lens[pos % f]) {
+					if(eras_count == (int) rs_nroots)
+						return false;
+					eras_pos[eras_count++] = pad + b;
+				}
+			}
+			if(!eras_count)
+				continue;
+
+			if(decode_rs_char(rs_handle, codeword, eras_pos, eras_count) < 0)
+				return false;
+			memcpy(&packet[n * k], codeword + pad, k);
+		}
+	}
+
+	af_len = c * k - slot.rs_z;
+	return true;
+}
+
+void PFTDecoder::FinishSlot(PFT_SLOT& slot) {
+	size_t af_len = 0;
+	bool ok;
+	if(slot.fec) {
+		ok = Recover(slot, af_len);
+	} else {
+		ok = slot.received == slot.fcount;
+		if(ok) {
+			for(size_t i = 0; i < slot.fcount; i++) {
+				memcpy(&packet[af_len], &slot.data[slot.fragment_offsets[i]], slot.fragment_lens[i]);
+				af_len += slot.fragment_lens[i];
+			}
+		}
+	}
+
+	if(!ok)
+		fprintf(stderr, "PFTDecoder: packet %u lost (%zu of %zu fragments missing)\n", slot.pseq, slot.fcount - slot.received, slot.fcount);
+
+	slot.used = false;
+	finished_pseqs[finished_count++ % (sizeof(finished_pseqs) / sizeof(finished_pseqs[0]))] = slot.pseq;
+
+	if(ok)
+		observer->PFTProcessAFPacket(&packet[0], af_len);
+}
+
+
+// --- EDISource -----------------------------------------------------------------
+EDISource::EDISource(std::string address, ETISourceObserver *observer) : ETINetworkSource(address, observer), pft_decoder(this) {
+	af_seq_next = 0;
+	af_seq_valid = false;
+	protocol_warned = false;
+	deti_found = false;
+	stream_count = 0;
+}
+
+bool EDISource::IsEDIAddress(const std::string& address) {
+	return address.compare(0, 4, "edi+") == 0 && IsNetworkAddress(address);
+}
+
+size_t EDISource::GetAFPacketLen(const uint8_t *data, size_t len, bool& valid) {
+	valid = true;
+	if(len < af_header_len)
+		return 0;
+
+	size_t payload_len = (uint32_t) data[2] << 24 | data[3] << 16 | data[4] << 8 | data[5];
+	bool cf = data[8] & 0x80;
+	int maj = (data[8] & 0x70) >> 4;
+	if(payload_len > max_af_payload_len || maj != 1 || data[9] != 'T') {
+		valid = false;
+		return 0;
+	}
+	return af_header_len + payload_len + (cf ? 2 : 0);
+}
+
+bool EDISource::CheckAFPacketCRC(const uint8_t *data, size_t len) {
+	// the CRC is optional
+	if(!(data[8] & 0x80))
+		return true;
+
+	uint16_t crc_stored = data[len - 2] << 8 | data[len - 1];
+	uint16_t crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(data, len - 2);
+	return crc_stored == crc_calced;
+}
+
+size_t EDISource::ProcessStream(const uint8_t *data, size_t len) {
+	size_t offset = 0;
+
+	// AF packets and PFT fragments may be mixed
+	while(len - offset >= 2) {
+		const uint8_t *packet = data + offset;
+		size_t available = len - offset;
+
+		bool pft = packet[0] == 'P' && packet[1] == 'F';
+		bool valid = false;
+		size_t packet_len = 0;
+		if(pft)
+			packet_len = PFTDecoder::GetFragmentLen(packet, available, valid);
+		else if(packet[0] == 'A' && packet[1] == 'F')
+			packet_len = GetAFPacketLen(packet, available, valid);
+
+		if(valid && (!packet_len || available < packet_len))
+			break;
+		if(valid && !pft)
+			valid = CheckAFPacketCRC(packet, packet_len);
+
+		if(!valid) {
+			if(synced) {
+				fprintf(stderr, "EDISource: packet sync lost\n");
+				synced = false;
+			}
+			offset++;
+			skipped_bytes++;
+			continue;
+		}
+
+		if(!synced) {
+			fprintf(stderr, "EDISource: packet sync found (%zu bytes skipped)\n", skipped_bytes);
+			synced = true;
+			skipped_bytes = 0;
+		}
+
+		if(pft)
+			pft_decoder.ProcessFragment(packet, packet_len);
+		else
+			DecodeAFPacket(packet, packet_len);
+		offset += packet_len;
+	}
+	return offset;
+}
+
+void EDISource::PFTProcessAFPacket(const uint8_t *data, size_t len) {
+	bool valid = false;
+	size_t af_len = len >= 2 && data[0] == 'A' && data[1] == 'F' ? GetAFPacketLen(data, len, valid) : 0;
+	if(!valid || af_len != len || !CheckAFPacketCRC(data, len)) {
+		fprintf(stderr, "EDISource: ignored invalid AF packet\n");
+		return;
+	}
+	DecodeAFPacket(data, len);
+}
+
+void EDISource::DecodeAFPacket(const uint8_t *data, size_t len) {
+	(void) len;
+
+	uint16_t seq = data[6] << 8 | data[7];
+	if(af_seq_valid && seq != af_seq_next)
+		fprintf(stderr, "EDISource: %u AF packet(s) missing\n", (uint16_t) (seq - af_seq_next));
+	af_seq_next = seq + 1;
+	af_seq_valid = true;
+
+	deti_found = false;
+	stream_count = 0;
+
+	// TAG items
+	const uint8_t *payload = data + af_header_len;
+	size_t payload_len = (uint32_t) data[2] << 24 | data[3] << 16 | data[4] << 8 | data[5];
+	for(size_t offset = 0; offset < payload_len;) {
+		if(payload_len - offset < 8) {
+			fprintf(stderr, "EDISource: ignored AF packet with truncated TAG item\n");
+			return;
+		}
+		const uint8_t *name = payload + offset;
+		size_t value_bits = (uint32_t) name[4] << 24 | name[5] << 16 | name[6] << 8 | name[7];
+		size_t value_len = (value_bits + 7) / 8;
+		if(value_len > payload_len - offset - 8) {
+			fprintf(stderr, "EDISource: ignored AF packet with truncated TAG item\n");
+			return;
+		}
+
+		if(!DecodeTagItem(name, name + 8, value_len))
+			return;
+		offset += 8 + value_len;
+	}
+
+	if(!deti_found) {
+		fprintf(stderr, "EDISource: ignored AF packet without DETI TAG item\n");
+		return;
+	}
+
+	if(BuildFrame()) {
+		observer->ETIProcessFrame(eti_frame);
+		eti_frame_count++;
+	}
+}
+
+bool EDISource::DecodeTagItem(const uint8_t *name, const uint8_t *value, size_t len) {
+	if(!memcmp(name, "*ptr", 4)) {
+		if(len < 4 || memcmp(value, "DETI", 4)) {
+			if(!protocol_warned) {
+				fprintf(stderr, "EDISource: ignored AF packets of unsupported protocol\n");
+				protocol_warned = true;
+			}
+			return false;
+		}
+		return true;
+	}
+	if(!memcmp(name, "deti", 4))
+		return DecodeDETI(value, len);
+	if(!memcmp(name, "est", 3))
+		return DecodeEST(name[3], value, len);
+
+	// other TAG items (e.g. padding) are not needed
+	return true;
+}
+
+bool EDISource::DecodeDETI(const uint8_t *value, size_t len) {
+	if(len < 6) {
+		fprintf(stderr, "EDISource: ignored AF packet with truncated DETI TAG item\n");
+		return false;
+	}
+
+	atstf = value[0] & 0x80;
+	ficf = value[0] & 0x40;
+	bool rfudf = value[0] & 0x20;
+	dflc = (value[0] & 0x1F) * 250 + value[1];
+	stat = value[2];
+	mid = value[3] >> 6;
+	fp = (value[3] & 0x38) >> 3;
+	bool rfu = value[3] & 0x01;
+	mnsc = rfu ? 0xFFFF : value[4] << 8 | value[5];
+
+	fic_len = ficf ? (mid == 3 ? 128 : 96) : 0;
+	size_t expected_len = 6 + (atstf ? 8 : 0) + fic_len + (rfudf ? 3 : 0);
+	if(len != expected_len) {
+		fprintf(stderr, "EDISource: ignored AF packet with DETI TAG item of wrong length\n");
+		return false;
+	}
+
+	size_t offset = 6;
+	if(atstf) {
+		// (UTCO and seconds are not needed)
+		tsta = value[offset + 5] << 16 | value[offset + 6] << 8 | value[offset + 7];
+		offset += 8;
+	}
+	fic_data = value + offset;
+
+	deti_found = true;
+	return true;
+}
+
+bool EDISource::DecodeEST(int n, const uint8_t *value, size_t len) {
+	if(n < 1 || n > 64 || len < 3 || (len - 3) % 8 || stream_count == 64) {
+		fprintf(stderr, "EDISource: ignored AF packet with invalid EST TAG item\n");
+		return false;
+	}
+
+	EDI_STREAM& stream = streams[stream_count++];
+	stream.scid = value[0] >> 2;
+	stream.sad = (value[0] & 0x03) << 8 | value[1];
+	stream.tpl = value[2] >> 2;
+	stream.data = value + 3;
+	stream.len = len - 3;
+	return true;
+}
+
+bool EDISource::BuildFrame() {
+	size_t mst_len = fic_len;
+	for(size_t i = 0; i < stream_count; i++)
+		mst_len += streams[i].len;
+
+	// SYNC + FC + STC + EOH + MST + EOF + TIST
+	if(4 + 4 + stream_count * 4 + 4 + mst_len + 4 + 4 > eti_frame_len) {
+		fprintf(stderr, "EDISource: ignored AF packet exceeding an ETI frame\n");
+		return false;
+	}
+
+	memset(eti_frame, 0x55, eti_frame_len);
+
+	// SYNC
+	eti_frame[0] = stat;
+	if(dflc % 2 == 0) {
+		eti_frame[1] = 0x07;
+		eti_frame[2] = 0x3A;
+		eti_frame[3] = 0xB6;
+	} else {
+		eti_frame[1] = 0xF8;
+		eti_frame[2] = 0xC5;
+		eti_frame[3] = 0x49;
+	}
+
+	// FC
+	int fl = stream_count + 1 + (mst_len / 4);
+	eti_frame[4] = dflc % 250;
+	eti_frame[5] = (ficf ? 0x80 : 0x00) | stream_count;
+	eti_frame[6] = fp << 5 | mid << 3 | fl >> 8;
+	eti_frame[7] = fl;
+
+	// STC
+	size_t offset = 8;
+	for(size_t i = 0; i < stream_count; i++) {
+		const EDI_STREAM& stream = streams[i];
+		int stl = stream.len / 8;
+		eti_frame[offset++] = stream.scid << 2 | stream.sad >> 8;
+		eti_frame[offset++] = stream.sad;
+		eti_frame[offset++] = stream.tpl << 2 | stl >> 8;
+		eti_frame[offset++] = stl;
+	}
+
+	// EOH
+	eti_frame[offset++] = mnsc >> 8;
+	eti_frame[offset++] = mnsc;
+	uint16_t header_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + 4, offset - 4);
+	eti_frame[offset++] = header_crc >> 8;
+	eti_frame[offset++] = header_crc;
+
+	// MST
+	size_t mst_offset = offset;
+	memcpy(eti_frame + offset, fic_data, fic_len);
+	offset += fic_len;
+	for(size_t i = 0; i < stream_count; i++) {
+		memcpy(eti_frame + offset, streams[i].data, streams[i].len);
+		offset += streams[i].len;
+	}
+
+	// EOF + TIST
+	uint16_t body_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + mst_offset, offset - mst_offset);
+	eti_frame[offset++] = body_crc >> 8;
+	eti_frame[offset++] = body_crc;
+	eti_frame[offset++] = 0xFF;
+	eti_frame[offset++] = 0xFF;
+	if(atstf) {
+		eti_frame[offset++] = tsta >> 16;
+		eti_frame[offset++] = tsta >> 8;
+		eti_frame[offset++] = tsta;
+		eti_frame[offset++] = 0xFF;
+	} else {
+		memset(eti_frame + offset, 0xFF, 4);
+	}
+	return true;
+}
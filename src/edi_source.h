@@ -0,0 +1,175 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EDI_SOURCE_H_
+#define EDI_SOURCE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <fec.h>
+}
+
+#include "eti_network_source.h"
+#include "tools.h"
+
+
+// --- PFTDecoderObserver -----------------------------------------------------------------
+class PFTDecoderObserver {
+public:
+	virtual ~PFTDecoderObserver() {};
+
+	virtual void PFTProcessAFPacket(const uint8_t* /*data*/, size_t /*len*/) {};
+};
+
+
+// --- PFT_SLOT -----------------------------------------------------------------
+struct PFT_SLOT {
+	bool used;
+	uint16_t pseq;
+	size_t fcount;
+	size_t received;
+	bool fec;
+	size_t rs_k;
+	size_t rs_z;
+	size_t plen;		// of all fragments (with FEC)
+
+	// fragments in order of arrival
+	std::vector<uint8_t> data;
+	size_t data_used;
+	std::vector<size_t> fragment_offsets;
+	std::vector<size_t> fragment_lens;		// 0 = missing
+};
+
+
+// --- PFTDecoder -----------------------------------------------------------------
+/* Reassembles AF packets from PFT fragments (ETSI TS 102 821), recovering
+ * missing fragments by means of the RS(255,207) code, if present. As soon as
+ * enough fragments of a packet have arrived, the packet is passed on - so
+ * usually in order. As a sender may interleave the fragments of several
+ * packets, up to max_delay_packets packets are reassembled at once; a packet
+ * still incomplete when it falls out of this window is dropped.
+ *
+ * All buffers are allocated once, so that no memory is allocated during
+ * operation.
+ */
+class PFTDecoder {
+private:
+	PFTDecoderObserver *observer;
+	void *rs_handle;
+
+	static const size_t max_delay_packets = 8;		// ~200ms
+
+	PFT_SLOT slots[max_delay_packets];
+	uint16_t newest_pseq;
+	bool newest_pseq_valid;
+	uint16_t finished_pseqs[2 * max_delay_packets];		// ring of the latest finished packets
+	size_t finished_count;
+
+	std::vector<uint8_t> packet;		// reassembled (RS) packet
+
+	PFT_SLOT* GetSlot(uint16_t pseq);
+	bool IsFinished(uint16_t pseq);
+	void FinishSlot(PFT_SLOT& slot);
+	bool CanRecover(const PFT_SLOT& slot);
+	bool Recover(const PFT_SLOT& slot, size_t& af_len);
+
+	static const size_t header_min_len = 12;		// without HCRC
+	static const size_t max_fragments = 1024;
+	static const size_t max_packet_len = 64 * 1024;
+	static const size_t rs_nn = 255;
+	static const size_t rs_nroots = 48;
+public:
+	PFTDecoder(PFTDecoderObserver *observer);
+	~PFTDecoder();
+
+	void ProcessFragment(const uint8_t *data, size_t len);
+
+	// returns 0, if more data is needed (or the header is invalid)
+	static size_t GetFragmentLen(const uint8_t *data, size_t len, bool& valid);
+};
+
+
+// --- EDI_STREAM -----------------------------------------------------------------
+struct EDI_STREAM {
+	int scid;
+	int sad;
+	int tpl;
+	const uint8_t *data;
+	size_t len;
+};
+
+
+// --- EDISource -----------------------------------------------------------------
+/* Receives EDI (ETSI TS 102 693) in form of AF packets - either directly or
+ * fragmented by PFT - from the network, addressed like ETINetworkSource but
+ * prefixed by "edi+" (e.g. "edi+udp://239.1.2.3:5001").
+ *
+ * From the TAG items of each AF packet, an equivalent ETI frame is rebuilt,
+ * so that any ETISourceObserver can be used as usual.
+ */
+class EDISource : public ETINetworkSource, PFTDecoderObserver {
+private:
+	PFTDecoder pft_decoder;
+	uint16_t af_seq_next;
+	bool af_seq_valid;
+	bool protocol_warned;
+
+	// values of the current AF packet
+	bool deti_found;
+	int stat;
+	int mid;
+	int fp;
+	int dflc;
+	bool ficf;
+	const uint8_t *fic_data;
+	size_t fic_len;
+	uint16_t mnsc;
+	uint32_t tsta;
+	bool atstf;
+	EDI_STREAM streams[64];
+	size_t stream_count;
+
+	uint8_t eti_frame[eti_frame_len];
+
+	size_t ProcessStream(const uint8_t *data, size_t len);
+	void PFTProcessAFPacket(const uint8_t *data, size_t len);
+	void DecodeAFPacket(const uint8_t *data, size_t len);
+	bool DecodeTagItem(const uint8_t *name, const uint8_t *value, size_t len);
+	bool DecodeDETI(const uint8_t *value, size_t len);
+	bool DecodeEST(int n, const uint8_t *value, size_t len);
+	bool BuildFrame();
+
+	static size_t GetAFPacketLen(const uint8_t *data, size_t len, bool& valid);
+	static bool CheckAFPacketCRC(const uint8_t *data, size_t len);
+
+	static const size_t af_header_len = 10;
+	static const size_t max_af_payload_len = 64 * 1024;
+public:
+	EDISource(std::string address, ETISourceObserver *observer);
+
+	static bool IsEDIAddress(const std::string& address);
+};
+
+
+
+#endif /* EDI_SOURCE_H_ */
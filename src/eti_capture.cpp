@@ -0,0 +1,415 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_capture.h"
+
+static const uint8_t capture_magic[] = {'D', 'A', 'B', 'L', 'C', 'A', 'P'};
+static const uint8_t capture_version = 1;
+
+
+// --- ETI_CAPTURE_RECORD -----------------------------------------------------------------
+void ETI_CAPTURE_RECORD::Write(uint8_t *data) const {
+	data[0] = cif_count >> 24;
+	data[1] = cif_count >> 16;
+	data[2] = cif_count >> 8;
+	data[3] = cif_count;
+	data[4] = id;
+	data[5] = 0x00;
+	data[6] = len >> 8;
+	data[7] = len;
+	for(int i = 0; i < 8; i++)
+		data[8 + i] = timestamp >> (56 - i * 8);
+}
+
+void ETI_CAPTURE_RECORD::Read(const uint8_t *data) {
+	cif_count = (uint32_t) data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+	id = data[4];
+	len = data[6] << 8 | data[7];
+	timestamp = 0;
+	for(int i = 0; i < 8; i++)
+		timestamp = timestamp << 8 | data[8 + i];
+}
+
+
+// --- ETICaptureWriter -----------------------------------------------------------------
+const int ETICaptureWriter::batch_timeout_ms;
+
+ETICaptureWriter::ETICaptureWriter(bool capture_fic, const std::vector<int>& subchids) {
+	this->capture_fic = capture_fic;
+
+	// no sub-channels stated means all sub-channels
+	for(int subchid = 0; subchid < 64; subchid++)
+		capture_subchannels[subchid] = subchids.empty();
+	for(int subchid : subchids)
+		if(subchid >= 0 && subchid < 64)
+			capture_subchannels[subchid] = true;
+
+	cif_count = 0;
+	frame_records.reserve(ETIFrameParser::eti_frame_len + 65 * ETI_CAPTURE_RECORD::header_len);
+
+	output_file = NULL;
+	buffer.reserve(batch_len);
+	do_exit = false;
+	dropped_frames = 0;
+}
+
+ETICaptureWriter::~ETICaptureWriter() {
+	if(writer_thread.joinable()) {
+		// let the writer write all pending records
+		{
+			std::lock_guard<std::mutex> lock(buffer_mutex);
+			do_exit = true;
+		}
+		buffer_cond.notify_one();
+		writer_thread.join();
+	}
+
+	if(output_file)
+		fclose(output_file);
+
+	if(dropped_frames)
+		fprintf(stderr, "ETICaptureWriter: %zu ETI frame(s) not captured, as the writer was too slow\n", dropped_frames);
+}
+
+bool ETICaptureWriter::Open(const std::string& filename) {
+	output_file = fopen(filename.c_str(), "wb");
+	if(!output_file) {
+		perror("ETICaptureWriter: error opening output file");
+		return false;
+	}
+
+	uint8_t header[sizeof(capture_magic) + 1];
+	memcpy(header, capture_magic, sizeof(capture_magic));
+	header[sizeof(capture_magic)] = capture_version;
+	if(fwrite(header, sizeof(header), 1, output_file) != 1) {
+		perror("ETICaptureWriter: error writing file header");
+		return false;
+	}
+
+	fprintf(stderr, "ETICaptureWriter: capturing to '%s'\n", filename.c_str());
+	writer_thread = std::thread(&ETICaptureWriter::WriterLoop, this);
+	return true;
+}
+
+void ETICaptureWriter::ProcessFrame(const uint8_t *eti_frame) {
+	if(!parser.Parse(eti_frame))
+		return;
+
+	uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+	// collect the records of this frame first, to keep the lock short
+	frame_records.clear();
+	if(capture_fic) {
+		size_t fic_len;
+		const uint8_t *fic_data = parser.GetFIC(fic_len);
+		if(fic_data)
+			AddRecord(ETI_CAPTURE_RECORD::record_id_fic, fic_data, fic_len, timestamp);
+	}
+	if(parser.IsBodyUsable()) {
+		for(int subchid = 0; subchid < 64; subchid++) {
+			if(!capture_subchannels[subchid])
+				continue;
+			ETI_SUBCHANNEL subchannel = parser.GetSubchannel(subchid);
+			if(!subchannel.IsNone())
+				AddRecord(subchid, subchannel.data, subchannel.len, timestamp);
+		}
+	}
+	cif_count++;
+
+	if(frame_records.empty())
+		return;
+
+	bool batch_complete;
+	{
+		std::lock_guard<std::mutex> lock(buffer_mutex);
+
+		// never wait for the writer
+		if(buffer.size() + frame_records.size() > max_buffer_len) {
+			dropped_frames++;
+			return;
+		}
+		buffer.insert(buffer.end(), frame_records.begin(), frame_records.end());
+		batch_complete = buffer.size() >= batch_len;
+	}
+	if(batch_complete)
+		buffer_cond.notify_one();
+}
+
+void ETICaptureWriter::AddRecord(int id, const uint8_t *data, size_t len, uint64_t timestamp) {
+	ETI_CAPTURE_RECORD record;
+	record.cif_count = cif_count;
+	record.id = id;
+	record.len = len;
+	record.timestamp = timestamp;
+
+	size_t offset = frame_records.size();
+	frame_records.resize(offset + ETI_CAPTURE_RECORD::header_len + len);
+	record.Write(&frame_records[offset]);
+	memcpy(&frame_records[offset + ETI_CAPTURE_RECORD::header_len], data, len);
+}
+
+void ETICaptureWriter::WriterLoop() {
+	std::vector<uint8_t> batch;
+	batch.reserve(batch_len);
+
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(buffer_mutex);
+			buffer_cond.wait_for(lock, std::chrono::milliseconds(batch_timeout_ms), [&]{return do_exit || buffer.size() >= batch_len;});
+
+			if(buffer.empty() && do_exit)
+				break;
+			buffer.swap(batch);
+		}
+
+		if(!batch.empty() && fwrite(&batch[0], batch.size(), 1, output_file) != 1)
+			perror("ETICaptureWriter: error writing records");
+		batch.clear();
+	}
+
+	if(fflush(output_file))
+		perror("ETICaptureWriter: error flushing output file");
+}
+
+
+// --- ETICaptureSource -----------------------------------------------------------------
+bool ETICaptureSource::IsCaptureFile(const std::string& filename) {
+	if(filename.empty())
+		return false;
+
+	FILE *file = fopen(filename.c_str(), "rb");
+	if(!file)
+		return false;
+
+	uint8_t magic[sizeof(capture_magic)];
+	bool result = fread(magic, sizeof(magic), 1, file) == 1 && !memcmp(magic, capture_magic, sizeof(magic));
+	fclose(file);
+	return result;
+}
+
+void ETICaptureSource::PrintSource() {
+	fprintf(stderr, "ETICaptureSource: replaying capture '%s'\n", filename.c_str());
+}
+
+bool ETICaptureSource::ReadHeader() {
+	uint8_t header[sizeof(capture_magic) + 1];
+	if(fread(header, sizeof(header), 1, input_file) != 1 || memcmp(header, capture_magic, sizeof(capture_magic))) {
+		fprintf(stderr, "ETICaptureSource: no capture file!\n");
+		return false;
+	}
+	if(header[sizeof(capture_magic)] != capture_version) {
+		fprintf(stderr, "ETICaptureSource: capture version %d not supported!\n", header[sizeof(capture_magic)]);
+		return false;
+	}
+	return true;
+}
+
+bool ETICaptureSource::ReadRecord(ETI_CAPTURE_RECORD& record, uint8_t *data) {
+	uint8_t header[ETI_CAPTURE_RECORD::header_len];
+	if(fread(header, sizeof(header), 1, input_file) != 1)
+		return false;
+	record.Read(header);
+
+	if(record.len > 1023 * 8 || fread(data, record.len, 1, input_file) != 1) {
+		fprintf(stderr, "ETICaptureSource: truncated or invalid record at CIF %u\n", record.cif_count);
+		return false;
+	}
+	return true;
+}
+
+bool ETICaptureSource::SeekRecords(size_t frame, ETI_CAPTURE_RECORD& record, uint8_t *data) {
+	fprintf(stderr, "ETICaptureSource: seeking to %s\n", FramecountToTimecode(frame).c_str());
+
+	// records can only be found by reading them, so seeking backwards restarts at the first one
+	if(frame < record.cif_count - first_cif_count) {
+		if(fseeko(input_file, sizeof(capture_magic) + 1, SEEK_SET)) {
+			perror("ETICaptureSource: error seeking input file");
+			return false;
+		}
+		if(!ReadRecord(record, data))
+			return false;
+	}
+
+	while(record.cif_count - first_cif_count < frame) {
+		if(!ReadRecord(record, data))
+			return false;
+	}
+	eti_frame_count = record.cif_count - first_cif_count;
+	return true;
+}
+
+void ETICaptureSource::ResetFrame() {
+	fic_len = 0;
+	mst_len = 0;
+	for(int subchid = 0; subchid < 64; subchid++)
+		subchannel_lens[subchid] = 0;
+}
+
+bool ETICaptureSource::AddToFrame(const ETI_CAPTURE_RECORD& record, const uint8_t *data) {
+	// the FIC is always put first
+	if(record.id == ETI_CAPTURE_RECORD::record_id_fic) {
+		if((record.len != 96 && record.len != 128) || fic_len || mst_len) {
+			fprintf(stderr, "ETICaptureSource: ignored FIC record at CIF %u\n", record.cif_count);
+			return false;
+		}
+		fic_len = record.len;
+	} else {
+		if(record.id >= 64 || record.len % 8 || subchannel_lens[record.id]) {
+			fprintf(stderr, "ETICaptureSource: ignored sub-channel record at CIF %u\n", record.cif_count);
+			return false;
+		}
+		subchannel_offsets[record.id] = mst_len;
+		subchannel_lens[record.id] = record.len;
+	}
+
+	// keep the space of the ETI frame header (max. 64 sub-channels) and the EOF/TIST
+	if(4 + 4 + 64 * 4 + 4 + mst_len + record.len + 8 > eti_frame_len) {
+		fprintf(stderr, "ETICaptureSource: ignored record at CIF %u exceeding the ETI frame\n", record.cif_count);
+		if(record.id != ETI_CAPTURE_RECORD::record_id_fic)
+			subchannel_lens[record.id] = 0;
+		else
+			fic_len = 0;
+		return false;
+	}
+	memcpy(frame_data + mst_len, data, record.len);
+	mst_len += record.len;
+	return true;
+}
+
+void ETICaptureSource::BuildFrame(uint32_t cif_count, uint8_t *eti_frame) {
+	memset(eti_frame, 0x55, eti_frame_len);
+
+	int nst = 0;
+	int stl_sum = 0;
+	for(int subchid = 0; subchid < 64; subchid++) {
+		if(subchannel_lens[subchid]) {
+			nst++;
+			stl_sum += subchannel_lens[subchid] / 8;
+		}
+	}
+
+	// SYNC
+	eti_frame[0] = 0xFF;
+	if(cif_count % 2 == 0) {
+		eti_frame[1] = 0x07;
+		eti_frame[2] = 0x3A;
+		eti_frame[3] = 0xB6;
+	} else {
+		eti_frame[1] = 0xF8;
+		eti_frame[2] = 0xC5;
+		eti_frame[3] = 0x49;
+	}
+
+	// FC
+	int fl = nst + 1 + fic_len / 4 + stl_sum * 2;
+	eti_frame[4] = cif_count % 250;
+	eti_frame[5] = (fic_len ? 0x80 : 0x00) | nst;
+	eti_frame[6] = (cif_count % 8) << 5 | (fic_len == 128 ? 3 : 1) << 3 | fl >> 8;
+	eti_frame[7] = fl;
+
+	// STC (in SubChId order, as the MST below)
+	size_t offset = 8;
+	int sad = 0;
+	size_t mst_offset = 8 + nst * 4 + 4;
+	size_t subchannel_offset = mst_offset + fic_len;
+	for(int subchid = 0; subchid < 64; subchid++) {
+		size_t len = subchannel_lens[subchid];
+		if(!len)
+			continue;
+		int stl = len / 8;
+		eti_frame[offset++] = subchid << 2 | sad >> 8;
+		eti_frame[offset++] = sad;
+		eti_frame[offset++] = stl >> 8;
+		eti_frame[offset++] = stl;
+		sad += stl;
+
+		memcpy(eti_frame + subchannel_offset, frame_data + subchannel_offsets[subchid], len);
+		subchannel_offset += len;
+	}
+
+	// EOH
+	eti_frame[offset++] = 0x00;
+	eti_frame[offset++] = 0x00;
+	uint16_t header_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + 4, offset - 4);
+	eti_frame[offset++] = header_crc >> 8;
+	eti_frame[offset++] = header_crc;
+
+	// MST (the FIC is always at the start of the collected data)
+	memcpy(eti_frame + mst_offset, frame_data, fic_len);
+	offset = mst_offset + fic_len + stl_sum * 8;
+
+	// EOF + TIST
+	uint16_t body_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + mst_offset, offset - mst_offset);
+	eti_frame[offset++] = body_crc >> 8;
+	eti_frame[offset++] = body_crc;
+	eti_frame[offset++] = 0xFF;
+	eti_frame[offset++] = 0xFF;
+	memset(eti_frame + offset, 0xFF, 4);
+}
+
+int ETICaptureSource::Main() {
+	if(!input_file) {
+		if(!OpenFile())
+			return 1;
+	}
+
+	PrintSource();
+
+	if(!ReadHeader())
+		return 1;
+
+	uint8_t eti_frame[eti_frame_len];
+	uint8_t record_data[1023 * 8];
+	ETI_CAPTURE_RECORD record;
+	bool record_pending = ReadRecord(record, record_data);
+	first_cif_count = record.cif_count;
+
+	while(record_pending) {
+		if(do_exit)
+			break;
+
+		if(seek_requested) {
+			size_t seek_target;
+			{
+				std::lock_guard<std::mutex> lock(status_mutex);
+
+				seek_target = seek_frame;
+				seek_requested = false;
+			}
+			record_pending = SeekRecords(seek_target, record, record_data);
+			if(!record_pending)
+				break;
+		}
+
+		// collect all records of the same CIF
+		uint32_t cif_count = record.cif_count;
+		ResetFrame();
+		do {
+			AddToFrame(record, record_data);
+			record_pending = ReadRecord(record, record_data);
+		} while(record_pending && record.cif_count == cif_count);
+
+		BuildFrame(cif_count, eti_frame);
+		observer->ETIProcessFrame(eti_frame);
+		eti_frame_count++;
+	}
+
+	if(!record_pending)
+		fprintf(stderr, "ETICaptureSource: EOF reached!\n");
+	return 0;
+}
@@ -0,0 +1,135 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_CAPTURE_H_
+#define ETI_CAPTURE_H_
+
+// support 2GB+ files on 32bit systems
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "eti_source.h"
+#include "eti_player.h"
+
+
+/* Capture container
+ *
+ * The file starts with a header (the magic "DABLCAP" plus a version byte),
+ * followed by one record per captured sub-channel/FIC and CIF:
+ *
+ * - CIF count (4 bytes; running count of the captured ETI frames)
+ * - ID (1 byte; SubChId or record_id_fic)
+ * - reserved (1 byte)
+ * - data len (2 bytes)
+ * - timestamp (8 bytes; µs since the epoch, at capture)
+ * - data
+ *
+ * All values are big-endian. The records of the same CIF are stored
+ * consecutively, the FIC first.
+ */
+struct ETI_CAPTURE_RECORD {
+	uint32_t cif_count;
+	int id;
+	size_t len;
+	uint64_t timestamp;
+
+	static const size_t header_len = 16;
+	static const int record_id_fic = 0x80;
+
+	ETI_CAPTURE_RECORD() : cif_count(0), id(0), len(0), timestamp(0) {}
+
+	void Write(uint8_t *data) const;
+	void Read(const uint8_t *data);
+};
+
+
+// --- ETICaptureWriter -----------------------------------------------------------------
+// Records the FIC and any set of sub-channels of the ETI frames. The
+// records are collected in memory and written in batches by a background
+// thread, so that the caller never waits for the disk.
+class ETICaptureWriter {
+private:
+	ETIFrameParser parser;
+	bool capture_fic;
+	bool capture_subchannels[64];
+	uint32_t cif_count;
+	std::vector<uint8_t> frame_records;
+
+	FILE *output_file;
+	std::thread writer_thread;
+	std::mutex buffer_mutex;
+	std::condition_variable buffer_cond;
+	std::vector<uint8_t> buffer;
+	bool do_exit;
+	size_t dropped_frames;
+
+	void AddRecord(int id, const uint8_t *data, size_t len, uint64_t timestamp);
+	void WriterLoop();
+
+	static const size_t batch_len = 256 * 1024;
+	static const size_t max_buffer_len = 16 * 1024 * 1024;
+	static const int batch_timeout_ms = 500;
+public:
+	ETICaptureWriter(bool capture_fic, const std::vector<int>& subchids);
+	~ETICaptureWriter();
+
+	bool Open(const std::string& filename);
+	void ProcessFrame(const uint8_t *eti_frame);
+};
+
+
+// --- ETICaptureSource -----------------------------------------------------------------
+// Replays a capture as (synthesized) ETI-NI frames, which only contain the
+// captured FIC/sub-channels.
+class ETICaptureSource : public ETISource {
+private:
+	uint8_t frame_data[eti_frame_len];
+	size_t fic_len;
+	size_t subchannel_offsets[64];
+	size_t subchannel_lens[64];
+	size_t mst_len;
+	uint32_t first_cif_count;
+
+	bool ReadHeader();
+	bool ReadRecord(ETI_CAPTURE_RECORD& record, uint8_t *data);
+	bool SeekRecords(size_t frame, ETI_CAPTURE_RECORD& record, uint8_t *data);
+	void ResetFrame();
+	bool AddToFrame(const ETI_CAPTURE_RECORD& record, const uint8_t *data);
+	void BuildFrame(uint32_t cif_count, uint8_t *eti_frame);
+
+	void PrintSource();
+public:
+	ETICaptureSource(std::string filename, ETISourceObserver *observer) : ETISource(filename, observer), fic_len(0), mst_len(0), first_cif_count(0) {}
+
+	int Main();
+
+	static bool IsCaptureFile(const std::string& filename);
+};
+
+
+
+#endif /* ETI_CAPTURE_H_ */
@@ -0,0 +1,298 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_index.h"
+
+
+// --- ETIFrameIndex -----------------------------------------------------------------
+const uint8_t ETIFrameIndex::index_magic[] = {'D', 'A', 'B', 'L', 'I', 'D', 'X'};
+
+ETIFrameIndex::ETIFrameIndex(const std::string& filename) : do_exit(false) {
+	this->filename = filename;
+	index_filename = filename + ".idx";
+}
+
+ETIFrameIndex::~ETIFrameIndex() {
+	do_exit = true;
+	if(build_thread.joinable())
+		build_thread.join();
+}
+
+bool ETIFrameIndex::GetFileStatus(struct stat& file_stat) {
+	if(stat(filename.c_str(), &file_stat)) {
+		perror("ETIFrameIndex: error getting file status");
+		return false;
+	}
+	return true;
+}
+
+void ETIFrameIndex::Start() {
+	struct stat file_stat;
+	if(!GetFileStatus(file_stat))
+		return;
+
+	if(Load(file_stat)) {
+		fprintf(stderr, "ETIFrameIndex: using index '%s'\n", index_filename.c_str());
+		return;
+	}
+
+	build_thread = std::thread(&ETIFrameIndex::Build, this, file_stat);
+}
+
+bool ETIFrameIndex::GetEntry(size_t frame, ETI_INDEX_ENTRY& entry) {
+	std::lock_guard<std::mutex> lock(entries_mutex);
+
+	// the entries are in frame order with a fixed interval
+	size_t index = frame / snapshot_interval;
+	if(index >= entries.size())
+		return false;
+	entry = entries[index];
+	return true;
+}
+
+bool ETIFrameIndex::Load(const struct stat& file_stat) {
+	FILE *index_file = fopen(index_filename.c_str(), "rb");
+	if(!index_file)
+		return false;
+
+	// header: magic, version, file size/mtime, interval, entry count
+	uint8_t header[sizeof(index_magic) + 1 + 8 + 8 + 4 + 4];
+	bool result = fread(header, sizeof(header), 1, index_file) == 1 && !memcmp(header, index_magic, sizeof(index_magic));
+	if(result) {
+		const uint8_t *data = header + sizeof(index_magic);
+		uint64_t size = 0;
+		uint64_t mtime = 0;
+		for(int i = 0; i < 8; i++) {
+			size = size << 8 | data[1 + i];
+			mtime = mtime << 8 | data[9 + i];
+		}
+		size_t interval = (uint32_t) data[17] << 24 | data[18] << 16 | data[19] << 8 | data[20];
+		size_t count = (uint32_t) data[21] << 24 | data[22] << 16 | data[23] << 8 | data[24];
+
+		// outdated, if the recording was changed meanwhile
+		result =
+				data[0] == index_version &&
+				size == (uint64_t) file_stat.st_size &&
+				mtime == (uint64_t) file_stat.st_mtime &&
+				interval == snapshot_interval;
+
+		std::vector<ETI_INDEX_ENTRY> loaded_entries(result ? count : 0);
+		for(ETI_INDEX_ENTRY& entry : loaded_entries) {
+			uint8_t entry_header[4 + 8 + 1 + 1 + 4];
+			if(fread(entry_header, sizeof(entry_header), 1, index_file) != 1) {
+				result = false;
+				break;
+			}
+			entry.frame = (uint32_t) entry_header[0] << 24 | entry_header[1] << 16 | entry_header[2] << 8 | entry_header[3];
+			for(int i = 0; i < 8; i++)
+				entry.offset = entry.offset << 8 | entry_header[4 + i];
+			entry.fct = entry_header[12];
+			size_t figs_len = (uint32_t) entry_header[14] << 24 | entry_header[15] << 16 | entry_header[16] << 8 | entry_header[17];
+
+			entry.figs.resize(figs_len);
+			if(figs_len && fread(&entry.figs[0], figs_len, 1, index_file) != 1) {
+				result = false;
+				break;
+			}
+		}
+
+		if(result) {
+			std::lock_guard<std::mutex> lock(entries_mutex);
+			entries.swap(loaded_entries);
+		}
+	}
+
+	fclose(index_file);
+	return result;
+}
+
+bool ETIFrameIndex::Save(const struct stat& file_stat) {
+	FILE *index_file = fopen(index_filename.c_str(), "wb");
+	if(!index_file) {
+		perror("ETIFrameIndex: error opening index file");
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(entries_mutex);
+
+	uint8_t header[sizeof(index_magic) + 1 + 8 + 8 + 4 + 4];
+	memcpy(header, index_magic, sizeof(index_magic));
+	uint8_t *data = header + sizeof(index_magic);
+	data[0] = index_version;
+	for(int i = 0; i < 8; i++) {
+		data[1 + i] = (uint64_t) file_stat.st_size >> (56 - i * 8);
+		data[9 + i] = (uint64_t) file_stat.st_mtime >> (56 - i * 8);
+	}
+	for(int i = 0; i < 4; i++) {
+		data[17 + i] = snapshot_interval >> (24 - i * 8);
+		data[21 + i] = entries.size() >> (24 - i * 8);
+	}
+	bool result = fwrite(header, sizeof(header), 1, index_file) == 1;
+
+	for(const ETI_INDEX_ENTRY& entry : entries) {
+		if(!result)
+			break;
+
+		uint8_t entry_header[4 + 8 + 1 + 1 + 4];
+		for(int i = 0; i < 4; i++)
+			entry_header[i] = entry.frame >> (24 - i * 8);
+		for(int i = 0; i < 8; i++)
+			entry_header[4 + i] = entry.offset >> (56 - i * 8);
+		entry_header[12] = entry.fct;
+		entry_header[13] = 0x00;
+		for(int i = 0; i < 4; i++)
+			entry_header[14 + i] = entry.figs.size() >> (24 - i * 8);
+
+		result = fwrite(entry_header, sizeof(entry_header), 1, index_file) == 1;
+		if(result && !entry.figs.empty())
+			result = fwrite(&entry.figs[0], entry.figs.size(), 1, index_file) == 1;
+	}
+
+	if(!result)
+		perror("ETIFrameIndex: error writing index file");
+	if(fclose(index_file)) {
+		perror("ETIFrameIndex: error closing index file");
+		result = false;
+	}
+	return result;
+}
+
+void ETIFrameIndex::Build(struct stat file_stat) {
+	FILE *input_file = fopen(filename.c_str(), "rb");
+	if(!input_file) {
+		perror("ETIFrameIndex: error opening input file");
+		return;
+	}
+
+	fprintf(stderr, "ETIFrameIndex: building index '%s' in the background\n", index_filename.c_str());
+
+	uint8_t eti_frame[eti_frame_len];
+	std::set<std::string> figs_previous;
+	std::set<std::string> figs_current;
+	size_t frame = 0;
+
+	for(; !do_exit; frame++) {
+		if(fread(eti_frame, sizeof(eti_frame), 1, input_file) != 1)
+			break;
+
+		// take a snapshot of the FIGs received so far (of the previous two intervals)
+		if(frame % snapshot_interval == 0) {
+			ETI_INDEX_ENTRY entry;
+			entry.frame = frame;
+			entry.offset = (uint64_t) frame * eti_frame_len;
+			entry.fct = eti_frame[4];
+
+			std::set<std::string> figs(figs_previous);
+			figs.insert(figs_current.begin(), figs_current.end());
+			for(const std::string& fig : figs)
+				entry.figs.insert(entry.figs.end(), fig.begin(), fig.end());
+
+			{
+				std::lock_guard<std::mutex> lock(entries_mutex);
+				entries.push_back(entry);
+			}
+
+			figs_previous.swap(figs_current);
+			figs_current.clear();
+		}
+
+		// (only) frames with correct ERR/FSYNC and FIC
+		uint32_t fsync = eti_frame[1] << 16 | eti_frame[2] << 8 | eti_frame[3];
+		if(eti_frame[0] != 0xFF || (fsync != 0x073AB6 && fsync != 0xF8C549) || !(eti_frame[5] & 0x80))
+			continue;
+
+		int nst = eti_frame[5] & 0x7F;
+		int mid = (eti_frame[6] & 0x18) >> 3;
+		CollectFIGs(eti_frame + 8 + nst * 4 + 4, mid == 3 ? 128 : 96, figs_current);
+	}
+	fclose(input_file);
+
+	if(do_exit)
+		return;
+
+	if(Save(file_stat))
+		fprintf(stderr, "ETIFrameIndex: index of %zu frames built\n", frame);
+}
+
+void ETIFrameIndex::CollectFIGs(const uint8_t *fic_data, size_t fic_len, std::set<std::string>& figs) {
+	for(size_t fib = 0; fib + 32 <= fic_len; fib += 32) {
+		const uint8_t *data = fic_data + fib;
+
+		// check CRC
+		uint16_t crc_stored = data[30] << 8 | data[31];
+		uint16_t crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(data, 30);
+		if(crc_stored != crc_calced)
+			continue;
+
+		for(size_t offset = 0; offset < 30 && data[offset] != 0xFF;) {
+			int type = data[offset] >> 5;
+			size_t len = data[offset] & 0x1F;
+			if(offset + 1 + len > 30)
+				break;
+
+			// skip FIGs changing all the time: FIG 0/0 (CIF count), FIG 0/10 (date/time)
+			bool keep = type == 1;
+			if(type == 0 && len) {
+				int extension = data[offset + 1] & 0x1F;
+				keep = extension != 0 && extension != 10;
+			}
+			if(keep)
+				figs.insert(std::string((const char*) data + offset, 1 + len));
+
+			offset += 1 + len;
+		}
+	}
+}
+
+void ETIFrameIndex::AppendFIB(uint8_t *fib, size_t fib_len, std::vector<uint8_t>& fic) {
+	// end marker + padding (if not completely filled)
+	if(fib_len < 30) {
+		fib[fib_len] = 0xFF;
+		memset(fib + fib_len + 1, 0x00, 30 - fib_len - 1);
+	}
+
+	uint16_t crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(fib, 30);
+	fib[30] = crc >> 8;
+	fib[31] = crc;
+	fic.insert(fic.end(), fib, fib + 32);
+}
+
+void ETIFrameIndex::FIGsToFIC(const std::vector<uint8_t>& figs, std::vector<uint8_t>& fic) {
+	fic.clear();
+
+	// pack as many FIGs as possible into each FIB
+	uint8_t fib[32];
+	size_t fib_len = 0;
+	for(size_t offset = 0; offset < figs.size();) {
+		size_t fig_len = 1 + (figs[offset] & 0x1F);
+		if(offset + fig_len > figs.size())
+			break;
+
+		if(fib_len + fig_len > 30) {
+			AppendFIB(fib, fib_len, fic);
+			fib_len = 0;
+		}
+
+		memcpy(fib + fib_len, &figs[offset], fig_len);
+		fib_len += fig_len;
+		offset += fig_len;
+	}
+
+	if(fib_len)
+		AppendFIB(fib, fib_len, fic);
+}
@@ -0,0 +1,97 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_INDEX_H_
+#define ETI_INDEX_H_
+
+// support 2GB+ files on 32bit systems
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+#include "tools.h"
+
+
+// --- ETI_INDEX_ENTRY -----------------------------------------------------------------
+struct ETI_INDEX_ENTRY {
+	size_t frame;
+	uint64_t offset;
+	int fct;						// CIF count (FCT) of the frame
+	std::vector<uint8_t> figs;		// FIC state: all distinct (static) FIGs recently received
+
+	ETI_INDEX_ENTRY() : frame(0), offset(0), fct(0) {}
+};
+
+
+// --- ETIFrameIndex -----------------------------------------------------------------
+/* Sidecar index of an ETI-NI recording (the recording's filename plus
+ * ".idx"). Every snapshot_interval frames it maps the frame (and so the
+ * time code) to the file offset and the CIF count, together with a
+ * snapshot of the FIC state at that point. The snapshot consists of the
+ * distinct FIGs which were received within the previous two intervals,
+ * except those changing all the time (CIF count, date/time); replayed into
+ * the FICDecoder, they restore services, sub-channels and labels at once.
+ *
+ * If no up-to-date sidecar exists, the index is built in the background.
+ */
+class ETIFrameIndex {
+private:
+	std::string filename;
+	std::string index_filename;
+
+	std::mutex entries_mutex;
+	std::vector<ETI_INDEX_ENTRY> entries;
+
+	std::thread build_thread;
+	std::atomic<bool> do_exit;
+
+	bool GetFileStatus(struct stat& file_stat);
+	bool Load(const struct stat& file_stat);
+	bool Save(const struct stat& file_stat);
+	void Build(struct stat file_stat);
+
+	static void CollectFIGs(const uint8_t *fic_data, size_t fic_len, std::set<std::string>& figs);
+	static void AppendFIB(uint8_t *fib, size_t fib_len, std::vector<uint8_t>& fic);
+
+	static const size_t eti_frame_len = 6144;
+	static const uint8_t index_magic[];
+	static const uint8_t index_version = 1;
+public:
+	ETIFrameIndex(const std::string& filename);
+	~ETIFrameIndex();
+
+	void Start();
+	bool GetEntry(size_t frame, ETI_INDEX_ENTRY& entry);
+
+	static void FIGsToFIC(const std::vector<uint8_t>& figs, std::vector<uint8_t>& fic);
+
+	static const size_t snapshot_interval = 250;	// 6s
+};
+
+
+
+#endif /* ETI_INDEX_H_ */
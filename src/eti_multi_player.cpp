@@ -0,0 +1,239 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_multi_player.h"
+
+
+// --- ETIMultiPlayerService -----------------------------------------------------------------
+ETIMultiPlayerService::ETIMultiPlayerService(const AUDIO_SERVICE& audio_service, const std::string& name, PASSTHROUGH_FORMAT passthrough_format) : audio_service(audio_service), name(name) {
+	if(audio_service.dab_plus)
+		dec = new SuperframeFilter(this, passthrough_format);
+	else if(passthrough_format != PASSTHROUGH_NONE)
+		dec = new MP2Passthrough(this);
+	else
+		dec = new MP2Decoder(this);
+	output_file = NULL;
+
+	queue_data = new uint8_t[queue_slots * max_subchannel_len];
+	queue_read = 0;
+	queue_count = 0;
+	scheduled = false;
+}
+
+ETIMultiPlayerService::~ETIMultiPlayerService() {
+	delete dec;
+	if(output_file)
+		fclose(output_file);
+	delete[] queue_data;
+}
+
+bool ETIMultiPlayerService::Open(const std::string& path) {
+	output_file = fopen(path.c_str(), "wb");
+	if(!output_file) {
+		perror("ETIMultiPlayerService: error opening output file");
+		return false;
+	}
+	setvbuf(output_file, NULL, _IOFBF, 64 * 1024);
+	return true;
+}
+
+void ETIMultiPlayerService::FormatChange(const std::string& format) {
+	fprintf(stderr, "ETIMultiPlayerService: %s: format: %s\n", name.c_str(), format.c_str());
+}
+
+void ETIMultiPlayerService::StartAudio(int samplerate, int channels, bool float32) {
+	fprintf(stderr, "ETIMultiPlayerService: %s: samplerate: %d, channels: %d, output: %s\n",
+			name.c_str(),
+			samplerate,
+			channels,
+			float32 ? "32bit float" : "16bit integer");
+}
+
+void ETIMultiPlayerService::PutAudio(const uint8_t *data, size_t len) {
+	if(fwrite(data, len, 1, output_file) != 1)
+		perror("ETIMultiPlayerService: error while writing audio");
+}
+
+
+// --- ETIMultiPlayer -----------------------------------------------------------------
+ETIMultiPlayer::ETIMultiPlayer(const std::string& output_dir, int jobs, bool unpaced, ETIPlayerObserver *observer) {
+	this->observer = observer;
+	this->output_dir = output_dir;
+	this->unpaced = unpaced;
+	passthrough_format = PASSTHROUGH_NONE;
+
+	frame_count = 0;
+	next_frame_time = std::chrono::steady_clock::now();
+
+	do_exit = false;
+
+	// use one worker per core, if not specified
+	if(jobs < 1)
+		jobs = std::max(std::thread::hardware_concurrency(), 1U);
+	fprintf(stderr, "ETIMultiPlayer: using %d worker threads\n", jobs);
+
+	for(int i = 0; i < jobs; i++)
+		workers.push_back(std::thread(&ETIMultiPlayer::Worker, this));
+}
+
+ETIMultiPlayer::~ETIMultiPlayer() {
+	// let the workers process all pending frames
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+		do_exit = true;
+	}
+	queue_cond.notify_all();
+
+	for(std::thread& worker : workers)
+		worker.join();
+
+	for(multi_player_services_t::iterator it = services.begin(); it != services.end(); it++)
+		delete it->second;
+}
+
+void ETIMultiPlayer::AddService(const LISTED_SERVICE& service) {
+	int subchid = service.audio_service.subchid;
+
+	// ignore services without (new) sub-channel
+	if(service.audio_service.IsNone() || services.find(subchid) != services.end())
+		return;
+
+	char name_string[16];
+	if(service.IsPrimary())
+		snprintf(name_string, sizeof(name_string), "%04X", service.sid);
+	else
+		snprintf(name_string, sizeof(name_string), "%04X-%d", service.sid, service.scids);
+	std::string name = name_string;
+
+	std::string label = FICDecoder::ConvertLabelToUTF8(service.label);
+	fprintf(stderr, "ETIMultiPlayer: decoding sub-channel %d (%s) as '%s': %s\n", subchid, service.audio_service.dab_plus ? "DAB+" : "DAB", name.c_str(), label.c_str());
+
+	// the audio may be passed through instead of decoded
+	std::string extension = ".pcm";
+	if(!service.audio_service.dab_plus) {
+		if(passthrough_format != PASSTHROUGH_NONE)
+			extension = ".mp2";
+	} else {
+		switch(passthrough_format) {
+		case PASSTHROUGH_ADTS:
+			extension = ".aac";
+			break;
+		case PASSTHROUGH_LATM:
+			extension = ".loas";
+			break;
+		default:
+			break;
+		}
+	}
+
+	ETIMultiPlayerService *multi_player_service = new ETIMultiPlayerService(service.audio_service, name, passthrough_format);
+	if(!multi_player_service->Open(output_dir + "/" + name + extension)) {
+		delete multi_player_service;
+		return;
+	}
+
+	services[subchid] = multi_player_service;
+}
+
+void ETIMultiPlayer::ProcessFrame(const uint8_t *data) {
+	// flow control (not needed, if decoding as fast as possible)
+	if(unpaced) {
+		if(frame_count == 0)
+			first_frame_time = std::chrono::steady_clock::now();
+	} else {
+		std::this_thread::sleep_until(next_frame_time);
+		next_frame_time += std::chrono::milliseconds(24);
+	}
+	frame_count++;
+
+	// parse the frame only once for all services
+	if(!parser.Parse(data))
+		return;
+
+	size_t fic_len;
+	const uint8_t *fic_data = parser.GetFIC(fic_len);
+	if(fic_data && observer)
+		observer->ETIProcessFIC(fic_data, fic_len);
+
+	if(!parser.IsBodyUsable())
+		return;
+
+	for(multi_player_services_t::iterator it = services.begin(); it != services.end(); it++) {
+		ETI_SUBCHANNEL subchannel = parser.GetSubchannel(it->first);
+		if(subchannel.IsNone())
+			continue;
+		Enqueue(it->second, subchannel);
+	}
+}
+
+void ETIMultiPlayer::Enqueue(ETIMultiPlayerService *service, const ETI_SUBCHANNEL& subchannel) {
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	// wait for a free slot, as the service's decoder is still busy
+	while(service->queue_count == ETIMultiPlayerService::queue_slots)
+		queue_space_cond.wait(lock);
+
+	size_t slot = (service->queue_read + service->queue_count) % ETIMultiPlayerService::queue_slots;
+	memcpy(service->QueueSlot(slot), subchannel.data, subchannel.len);
+	service->queue_len[slot] = subchannel.len;
+	service->queue_count++;
+
+	// hand the service to a worker, if not already done
+	if(!service->scheduled) {
+		service->scheduled = true;
+		ready_services.push_back(service);
+		queue_cond.notify_one();
+	}
+}
+
+void ETIMultiPlayer::Worker() {
+	std::unique_lock<std::mutex> lock(queue_mutex);
+
+	for(;;) {
+		while(!do_exit && ready_services.empty())
+			queue_cond.wait(lock);
+		if(ready_services.empty())
+			return;
+
+		ETIMultiPlayerService *service = ready_services.front();
+		ready_services.pop_front();
+
+		// a service is only processed by one worker at once, so its frames remain in order
+		while(service->queue_count) {
+			size_t slot = service->queue_read;
+
+			lock.unlock();
+			service->dec->Feed(service->QueueSlot(slot), service->queue_len[slot]);
+			lock.lock();
+
+			service->queue_read = (service->queue_read + 1) % ETIMultiPlayerService::queue_slots;
+			service->queue_count--;
+			queue_space_cond.notify_all();
+		}
+		service->scheduled = false;
+	}
+}
+
+void ETIMultiPlayer::PrintSpeed() {
+	if(frame_count == 0)
+		return;
+
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - first_frame_time).count();
+	double fps = duration > 0 ? frame_count / duration : 0;
+	fprintf(stderr, "ETIMultiPlayer: processed %zu frames of %zu services in %.3f s (%.1f frames/s = %.1fx real-time)\n", frame_count, services.size(), duration, fps, fps * 0.024);
+}
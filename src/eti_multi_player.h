@@ -0,0 +1,115 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_MULTI_PLAYER_H_
+#define ETI_MULTI_PLAYER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "subchannel_sink.h"
+#include "dab_decoder.h"
+#include "dabplus_decoder.h"
+#include "eti_player.h"
+#include "fic_decoder.h"
+#include "tools.h"
+
+
+// --- ETIMultiPlayerService -----------------------------------------------------------------
+class ETIMultiPlayerService : SubchannelSinkObserver {
+	friend class ETIMultiPlayer;
+private:
+	static const size_t queue_slots = 16;
+	static const size_t max_subchannel_len = 1023 * 8;
+
+	AUDIO_SERVICE audio_service;
+	std::string name;
+
+	SubchannelSink *dec;
+	FILE *output_file;
+
+	// frame queue (guarded by the ETIMultiPlayer)
+	uint8_t *queue_data;
+	size_t queue_len[queue_slots];
+	size_t queue_read;
+	size_t queue_count;
+	bool scheduled;
+
+	uint8_t* QueueSlot(size_t slot) {return queue_data + slot * max_subchannel_len;}
+
+	void FormatChange(const std::string& format);
+	void StartAudio(int samplerate, int channels, bool float32);
+	void PutAudio(const uint8_t *data, size_t len);
+public:
+	ETIMultiPlayerService(const AUDIO_SERVICE& audio_service, const std::string& name, PASSTHROUGH_FORMAT passthrough_format);
+	~ETIMultiPlayerService();
+
+	bool Open(const std::string& path);
+};
+
+typedef std::map<int, ETIMultiPlayerService*> multi_player_services_t;
+
+
+// --- ETIMultiPlayer -----------------------------------------------------------------
+class ETIMultiPlayer {
+private:
+	ETIPlayerObserver *observer;
+	std::string output_dir;
+	PASSTHROUGH_FORMAT passthrough_format;
+
+	bool unpaced;
+	size_t frame_count;
+	std::chrono::steady_clock::time_point first_frame_time;
+	std::chrono::steady_clock::time_point next_frame_time;
+
+	ETIFrameParser parser;
+	multi_player_services_t services;
+
+	std::mutex queue_mutex;
+	std::condition_variable queue_cond;
+	std::condition_variable queue_space_cond;
+	std::deque<ETIMultiPlayerService*> ready_services;
+	bool do_exit;
+	std::vector<std::thread> workers;
+
+	void Worker();
+	void Enqueue(ETIMultiPlayerService *service, const ETI_SUBCHANNEL& subchannel);
+public:
+	ETIMultiPlayer(const std::string& output_dir, int jobs, bool unpaced, ETIPlayerObserver *observer);
+	~ETIMultiPlayer();
+
+	void ProcessFrame(const uint8_t *data);
+	void PrintSpeed();
+	void SetStrictBodyCRC(bool strict_body_crc) {parser.SetStrictBodyCRC(strict_body_crc);}
+	void SetPassthrough(PASSTHROUGH_FORMAT passthrough_format) {this->passthrough_format = passthrough_format;}
+	size_t GetBodyCRCErrors() const {return parser.GetBodyCRCErrors();}
+
+	void AddService(const LISTED_SERVICE& service);
+};
+
+
+
+#endif /* ETI_MULTI_PLAYER_H_ */
@@ -0,0 +1,432 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_network_source.h"
+
+
+// --- ETINetworkSource -----------------------------------------------------------------
+const int ETINetworkSource::reconnect_delay_max_ms;
+
+ETINetworkSource::ETINetworkSource(std::string address, ETISourceObserver *observer) : ETISource(address, observer) {
+	protocol = PROTOCOL_TCP_CLIENT;
+
+	listen_fd = -1;
+	socket_fd = -1;
+	connecting = false;
+	reconnect_pending = false;
+	reconnect_delay_ms = 0;
+
+	buffer.resize(buffer_len);
+	buffer_used = 0;
+	synced = false;
+	skipped_bytes = 0;
+}
+
+ETINetworkSource::~ETINetworkSource() {
+	CloseSocket();
+	if(listen_fd != -1)
+		close(listen_fd);
+}
+
+bool ETINetworkSource::IsNetworkAddress(const std::string& address) {
+	// (EDI uses the same addresses, prefixed by "edi+")
+	size_t start = address.compare(0, 4, "edi+") == 0 ? 4 : 0;
+	return address.compare(start, 6, "tcp://") == 0 || address.compare(start, 6, "udp://") == 0;
+}
+
+bool ETINetworkSource::ParseAddress() {
+	if(!IsNetworkAddress(filename)) {
+		fprintf(stderr, "ETINetworkSource: unsupported address '%s'\n", filename.c_str());
+		return false;
+	}
+	size_t scheme_end = filename.find("://");
+	protocol = filename.compare(scheme_end - 3, 6, "udp://") == 0 ? PROTOCOL_UDP : PROTOCOL_TCP_CLIENT;
+	std::string rest = filename.substr(scheme_end + 3);
+
+	// TCP: "@" (or no host) means to listen
+	if(protocol == PROTOCOL_TCP_CLIENT && !rest.empty() && rest[0] == '@') {
+		protocol = PROTOCOL_TCP_SERVER;
+		rest = rest.substr(1);
+	}
+
+	size_t colon = rest.rfind(':');
+	if(colon == std::string::npos || colon + 1 == rest.length()) {
+		fprintf(stderr, "ETINetworkSource: no port within address '%s'\n", filename.c_str());
+		return false;
+	}
+	host = rest.substr(0, colon);
+	port = rest.substr(colon + 1);
+
+	// IPv6 addresses are enclosed in brackets
+	if(host.length() >= 2 && host[0] == '[' && host[host.length() - 1] == ']')
+		host = host.substr(1, host.length() - 2);
+
+	if(protocol == PROTOCOL_TCP_CLIENT && host.empty())
+		protocol = PROTOCOL_TCP_SERVER;
+	return true;
+}
+
+void ETINetworkSource::PrintSource() {
+	switch(protocol) {
+	case PROTOCOL_TCP_CLIENT:
+		fprintf(stderr, "ETINetworkSource: receiving from %s:%s via TCP\n", host.c_str(), port.c_str());
+		break;
+	case PROTOCOL_TCP_SERVER:
+		fprintf(stderr, "ETINetworkSource: listening on %s:%s via TCP\n", host.empty() ? "*" : host.c_str(), port.c_str());
+		break;
+	case PROTOCOL_UDP:
+		fprintf(stderr, "ETINetworkSource: receiving on %s:%s via UDP\n", host.empty() ? "*" : host.c_str(), port.c_str());
+		break;
+	}
+}
+
+int ETINetworkSource::CreateSocket(const addrinfo *addr) {
+	int fd = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, addr->ai_protocol);
+	if(fd == -1) {
+		perror("ETINetworkSource: error creating socket");
+		return -1;
+	}
+
+	// a large receive buffer bridges delays of the processing (accepted sockets inherit it)
+	int size = receive_buffer_size;
+	if(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)))
+		perror("ETINetworkSource: error setting receive buffer size");
+	return fd;
+}
+
+bool ETINetworkSource::Open() {
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = protocol == PROTOCOL_UDP ? SOCK_DGRAM : SOCK_STREAM;
+	hints.ai_flags = protocol == PROTOCOL_TCP_CLIENT ? 0 : AI_PASSIVE;
+
+	addrinfo *addrs;
+	int result = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &addrs);
+	if(result) {
+		fprintf(stderr, "ETINetworkSource: error resolving address: %s\n", gai_strerror(result));
+		return false;
+	}
+
+	bool opened = false;
+	for(const addrinfo *addr = addrs; addr && !opened; addr = addr->ai_next) {
+		switch(protocol) {
+		case PROTOCOL_TCP_CLIENT:
+			opened = OpenTCPClient(addr);
+			break;
+		case PROTOCOL_TCP_SERVER:
+			opened = OpenTCPServer(addr);
+			break;
+		case PROTOCOL_UDP:
+			opened = OpenUDP(addr);
+			break;
+		}
+	}
+
+	freeaddrinfo(addrs);
+	return opened;
+}
+
+bool ETINetworkSource::OpenTCPClient(const addrinfo *addr) {
+	socket_fd = CreateSocket(addr);
+	if(socket_fd == -1)
+		return false;
+
+	// the connection is established in the background
+	if(connect(socket_fd, addr->ai_addr, addr->ai_addrlen) == -1 && errno != EINPROGRESS) {
+		perror("ETINetworkSource: error connecting");
+		CloseSocket();
+		return false;
+	}
+	connecting = true;
+	if(!event_loop.Add(socket_fd, event_id_connect, EPOLLOUT)) {
+		CloseSocket();
+		return false;
+	}
+	return true;
+}
+
+bool ETINetworkSource::FinishConnect() {
+	int error = 0;
+	socklen_t error_len = sizeof(error);
+	if(getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error, &error_len))
+		error = errno;
+	if(error) {
+		fprintf(stderr, "ETINetworkSource: error connecting: %s\n", strerror(error));
+		return false;
+	}
+
+	// from now on, wait for data
+	connecting = false;
+	if(!event_loop.Remove(socket_fd) || !event_loop.Add(socket_fd, event_id_input))
+		return false;
+
+	fprintf(stderr, "ETINetworkSource: connected\n");
+	reconnect_delay_ms = 0;
+	return true;
+}
+
+bool ETINetworkSource::OpenTCPServer(const addrinfo *addr) {
+	listen_fd = CreateSocket(addr);
+	if(listen_fd == -1)
+		return false;
+
+	int reuse = 1;
+	if(setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)))
+		perror("ETINetworkSource: error setting address reuse");
+
+	if(bind(listen_fd, addr->ai_addr, addr->ai_addrlen) || listen(listen_fd, 1) || !event_loop.Add(listen_fd, event_id_listen)) {
+		perror("ETINetworkSource: error listening");
+		close(listen_fd);
+		listen_fd = -1;
+		return false;
+	}
+	return true;
+}
+
+bool ETINetworkSource::Accept() {
+	int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(fd == -1) {
+		if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+			return true;
+		perror("ETINetworkSource: error accepting client");
+		return false;
+	}
+
+	// only one client at once - the newest one
+	if(socket_fd != -1) {
+		fprintf(stderr, "ETINetworkSource: replacing the current client\n");
+		CloseSocket();
+	}
+
+	socket_fd = fd;
+	if(!event_loop.Add(socket_fd, event_id_input)) {
+		CloseSocket();
+		return false;
+	}
+	fprintf(stderr, "ETINetworkSource: client connected\n");
+	return true;
+}
+
+bool ETINetworkSource::OpenUDP(const addrinfo *addr) {
+	socket_fd = CreateSocket(addr);
+	if(socket_fd == -1)
+		return false;
+
+	int reuse = 1;
+	if(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)))
+		perror("ETINetworkSource: error setting address reuse");
+
+	// for a multicast group, receive on all interfaces and join the group
+	const sockaddr_in *addr_in = (const sockaddr_in*) addr->ai_addr;
+	bool multicast = addr->ai_family == AF_INET && IN_MULTICAST(ntohl(addr_in->sin_addr.s_addr));
+
+	sockaddr_in addr_any;
+	if(multicast) {
+		addr_any = *addr_in;
+		addr_any.sin_addr.s_addr = htonl(INADDR_ANY);
+	}
+	if(bind(socket_fd, multicast ? (const sockaddr*) &addr_any : addr->ai_addr, multicast ? sizeof(addr_any) : addr->ai_addrlen)) {
+		perror("ETINetworkSource: error binding socket");
+		CloseSocket();
+		return false;
+	}
+
+	if(multicast) {
+		ip_mreq mreq = {};
+		mreq.imr_multiaddr = addr_in->sin_addr;
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if(setsockopt(socket_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq))) {
+			perror("ETINetworkSource: error joining multicast group");
+			CloseSocket();
+			return false;
+		}
+	}
+
+	if(!event_loop.Add(socket_fd, event_id_input)) {
+		CloseSocket();
+		return false;
+	}
+	return true;
+}
+
+void ETINetworkSource::CloseSocket() {
+	if(socket_fd != -1) {
+		close(socket_fd);
+		socket_fd = -1;
+	}
+	connecting = false;
+
+	// a new connection starts unsynced
+	buffer_used = 0;
+	synced = false;
+	skipped_bytes = 0;
+}
+
+void ETINetworkSource::ScheduleReconnect() {
+	// double the delay on every failed attempt
+	reconnect_delay_ms = reconnect_delay_ms ? std::min(reconnect_delay_ms * 2, reconnect_delay_max_ms) : reconnect_delay_min_ms;
+	reconnect_time = std::chrono::steady_clock::now() + std::chrono::milliseconds(reconnect_delay_ms);
+	reconnect_pending = true;
+
+	fprintf(stderr, "ETINetworkSource: reconnecting in %d ms\n", reconnect_delay_ms);
+}
+
+bool ETINetworkSource::Receive() {
+	// read everything available
+	while(!do_exit) {
+		ssize_t bytes = recv(socket_fd, &buffer[buffer_used], buffer.size() - buffer_used, 0);
+		if(bytes == -1) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return true;
+			if(errno == EINTR)
+				continue;
+			perror("ETINetworkSource: error while receiving");
+			return false;
+		}
+		if(bytes == 0) {
+			// (empty datagrams are simply ignored)
+			if(protocol == PROTOCOL_UDP)
+				continue;
+			fprintf(stderr, "ETINetworkSource: connection closed\n");
+			return false;
+		}
+
+		buffer_used += bytes;
+		ProcessBuffer();
+	}
+	return true;
+}
+
+uint32_t ETINetworkSource::GetFSYNC(const uint8_t *data) {
+	return data[1] << 16 | data[2] << 8 | data[3];
+}
+
+void ETINetworkSource::ProcessBuffer() {
+	size_t offset = ProcessStream(&buffer[0], buffer_used);
+
+	// keep the remainder
+	memmove(&buffer[0], &buffer[offset], buffer_used - offset);
+	buffer_used -= offset;
+}
+
+size_t ETINetworkSource::ProcessStream(const uint8_t *data, size_t len) {
+	size_t offset = 0;
+
+	while(len - offset >= 4) {
+		uint32_t fsync = GetFSYNC(data + offset);
+		bool frame_start = fsync == 0x073AB6 || fsync == 0xF8C549;
+
+		if(!synced) {
+			/* To avoid locking on an FSYNC-like pattern within the frame
+			 * content, the next frame must start with the other FSYNC.
+			 */
+			if(frame_start) {
+				if(len - offset < eti_frame_len + 4)
+					break;
+				frame_start = GetFSYNC(data + offset + eti_frame_len) == (fsync ^ 0xFFFFFF);
+			}
+			if(!frame_start) {
+				offset++;
+				skipped_bytes++;
+				continue;
+			}
+
+			fprintf(stderr, "ETINetworkSource: frame sync found (%zu bytes skipped)\n", skipped_bytes);
+			synced = true;
+			skipped_bytes = 0;
+		} else if(!frame_start) {
+			fprintf(stderr, "ETINetworkSource: frame sync lost\n");
+			synced = false;
+			continue;
+		}
+
+		if(len - offset < eti_frame_len)
+			break;
+
+		observer->ETIProcessFrame(data + offset);
+		eti_frame_count++;
+		offset += eti_frame_len;
+	}
+	return offset;
+}
+
+int ETINetworkSource::Main() {
+	if(!ParseAddress())
+		return 1;
+
+	PrintSource();
+
+	// only a server should give up, if it cannot listen
+	if(!Open()) {
+		if(protocol == PROTOCOL_TCP_SERVER)
+			return 1;
+		ScheduleReconnect();
+	}
+
+	std::vector<int> ready_ids;
+	for(;;) {
+		if(do_exit)
+			break;
+
+		// streams cannot be rewound
+		if(seek_requested) {
+			fprintf(stderr, "ETISource: seeking is not possible within a stream\n");
+			seek_requested = false;
+		}
+
+		int timeout_ms = -1;
+		if(reconnect_pending) {
+			timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(reconnect_time - std::chrono::steady_clock::now()).count();
+			if(timeout_ms <= 0) {
+				reconnect_pending = false;
+				if(!Open())
+					ScheduleReconnect();
+				continue;
+			}
+		}
+
+		if(event_loop.Wait(ready_ids, timeout_ms) == -1)
+			return 1;
+
+		for(int id : ready_ids) {
+			bool ok = true;
+			switch(id) {
+			case event_id_listen:
+				if(!Accept())
+					return 1;
+				break;
+			case event_id_connect:
+				ok = FinishConnect();
+				break;
+			case event_id_input:
+				if(socket_fd != -1 && !connecting)
+					ok = Receive();
+				break;
+			}
+
+			// a server waits for the next client, otherwise reconnect
+			if(!ok) {
+				CloseSocket();
+				if(protocol != PROTOCOL_TCP_SERVER)
+					ScheduleReconnect();
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_NETWORK_SOURCE_H_
+#define ETI_NETWORK_SOURCE_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include "eti_source.h"
+
+
+// --- ETINetworkSource -----------------------------------------------------------------
+/* Receives ETI-NI from the network, addressed as:
+ *
+ * - "tcp://host:port": connect to a server (reconnecting, if the
+ *   connection fails or is closed)
+ * - "tcp://:port" (or "tcp://@host:port"): listen for a client (a new
+ *   client replaces the current one)
+ * - "udp://[host]:port": receive datagrams (a multicast group as host is
+ *   joined)
+ *
+ * The data is treated as byte stream regardless of any packet boundaries;
+ * the frames are (re-)aligned by means of the FSYNC pattern. Subclasses may
+ * interpret the stream differently.
+ */
+class ETINetworkSource : public ETISource {
+private:
+	enum PROTOCOL {PROTOCOL_TCP_CLIENT, PROTOCOL_TCP_SERVER, PROTOCOL_UDP};
+
+	PROTOCOL protocol;
+	std::string host;
+	std::string port;
+
+	int listen_fd;
+	int socket_fd;
+	bool connecting;
+	bool reconnect_pending;
+	int reconnect_delay_ms;
+	std::chrono::steady_clock::time_point reconnect_time;
+
+	std::vector<uint8_t> buffer;
+	size_t buffer_used;
+
+	bool ParseAddress();
+	bool Open();
+	bool OpenTCPClient(const addrinfo *addr);
+	bool OpenTCPServer(const addrinfo *addr);
+	bool OpenUDP(const addrinfo *addr);
+	bool Accept();
+	bool FinishConnect();
+	void CloseSocket();
+	void ScheduleReconnect();
+	bool Receive();
+	void ProcessBuffer();
+
+	void PrintSource();
+
+	static int CreateSocket(const addrinfo *addr);
+	static uint32_t GetFSYNC(const uint8_t *data);
+
+	static const int event_id_listen = 2;
+	static const int event_id_connect = 3;
+	static const size_t buffer_len = 128 * 1024;	// > max UDP datagram len + frame len
+	static const int receive_buffer_size = 4 * 1024 * 1024;
+	static const int reconnect_delay_min_ms = 500;
+	static const int reconnect_delay_max_ms = 8000;
+protected:
+	bool synced;
+	size_t skipped_bytes;
+
+	// returns the number of processed bytes
+	virtual size_t ProcessStream(const uint8_t *data, size_t len);
+public:
+	ETINetworkSource(std::string address, ETISourceObserver *observer);
+	~ETINetworkSource();
+
+	int Main();
+
+	static bool IsNetworkAddress(const std::string& address);
+};
+
+
+
+#endif /* ETI_NETWORK_SOURCE_H_ */
@@ -19,27 +19,265 @@
 #include "eti_player.h"
 
 
-// --- ETIPlayer -----------------------------------------------------------------
-ETIPlayer::ETIPlayer(bool pcm_output, ETIPlayerObserver *observer) {
-	this->observer = observer;
+// --- ETIFrameParser -----------------------------------------------------------------
+bool ETIFrameParser::Parse(const uint8_t *eti_frame) {
+	// ERR
+	if(eti_frame[0] != 0xFF) {
+		fprintf(stderr, "ETIFrameParser: ignored ETI frame with ERR = 0x%02X\n", eti_frame[0]);
+		return false;
+	}
 
-	next_frame_time = std::chrono::steady_clock::now();
+	uint32_t fsync = eti_frame[1] << 16 | eti_frame[2] << 8 | eti_frame[3];
+	if(fsync != 0x073AB6 && fsync != 0xF8C549) {
+		fprintf(stderr, "ETIFrameParser: ignored ETI frame with FSYNC = 0x%06X\n", fsync);
+		return false;
+	}
 
-	dec = NULL;
+	this->eti_frame = eti_frame;
+	int nst = eti_frame[5] & 0x7F;
+
+	// the slices (and the header fields they are derived from) only have to
+	// be (re)checked, if the stream characterisation changed; the frame phase
+	// is excluded, as it changes with every frame
+	size_t key_len = 3 + nst * 4;
+	if(key_len != stc_key_len ||
+			eti_frame[5] != stc_key[0] ||
+			(eti_frame[6] & 0x1F) != stc_key[1] ||
+			memcmp(eti_frame + 7, stc_key + 2, key_len - 2) != 0) {
+		if(!CheckHeaderCRC(nst))
+			return false;
+		if(!UpdateSlices(nst))
+			return false;
+
+		stc_key[0] = eti_frame[5];
+		stc_key[1] = eti_frame[6] & 0x1F;
+		memcpy(stc_key + 2, eti_frame + 7, key_len - 2);
+		stc_key_len = key_len;
+	}
+
+	CheckBodyCRC();
+	return true;
+}
+
+void ETIFrameParser::CheckBodyCRC() {
+	// EOF CRC over the whole MST
+	uint16_t body_crc_stored = eti_frame[mst_offset + mst_len] << 8 | eti_frame[mst_offset + mst_len + 1];
+	uint16_t body_crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + mst_offset, mst_len);
+	body_crc_ok = body_crc_stored == body_crc_calced;
+
+	if(!body_crc_ok) {
+		body_crc_errors++;
+
+		// in strict mode the sub-channel data is discarded
+		if(strict_body_crc)
+			fprintf(stderr, "\x1B[31m" "(ETI CRC)" "\x1B[0m" " ");
+	}
+}
+
+bool ETIFrameParser::CheckHeaderCRC(int nst) {
+	size_t header_crc_data_len = 4 + nst * 4 + 2;
+	uint16_t header_crc_stored = eti_frame[4 + header_crc_data_len] << 8 | eti_frame[4 + header_crc_data_len + 1];
+	uint16_t header_crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + 4, header_crc_data_len);
+	if(header_crc_stored != header_crc_calced) {
+		fprintf(stderr, "ETIFrameParser: ignored ETI frame due to wrong header CRC\n");
+		return false;
+	}
+	return true;
+}
+
+bool ETIFrameParser::UpdateSlices(int nst) {
+	bool ficf = eti_frame[5] & 0x80;
+	int mid = (eti_frame[6] & 0x18) >> 3;
+//	int fl = (eti_frame[6] & 0x07) << 8 | eti_frame[7];
+
+	int ficl = ficf ? (mid == 3 ? 32 : 24) : 0;
+	size_t offset = 8 + nst * 4 + 4;
+
+	mst_offset = offset;
+	fic_offset = offset;
+	fic_len = ficl * 4;
+	offset += fic_len;
+
+	// slice all sub-channels at once
+	for(int subchid = 0; subchid < 64; subchid++)
+		slices[subchid] = ETI_SUBCHANNEL_SLICE();
+
+	for(int i = 0; i < nst; i++) {
+		int scid = (eti_frame[8 + i*4] & 0xFC) >> 2;
+		int stl = (eti_frame[8 + i*4 + 2] & 0x03) << 8 | eti_frame[8 + i*4 + 3];
+
+		ETI_SUBCHANNEL_SLICE& slice = slices[scid];
+		slice.offset = offset;
+		slice.len = stl * 8;
+		offset += slice.len;
+	}
+
+	mst_len = offset - mst_offset;
+
+	// the MST (plus EOF) must fit into the frame
+	if(offset + 4 > eti_frame_len) {
+		fprintf(stderr, "ETIFrameParser: ignored ETI frame with too long MST\n");
+		stc_key_len = 0;
+		for(int subchid = 0; subchid < 64; subchid++)
+			slices[subchid] = ETI_SUBCHANNEL_SLICE();
+		fic_len = 0;
+		mst_len = 0;
+		return false;
+	}
+
+	return true;
+}
 
+
+// --- ETIPlayer -----------------------------------------------------------------
+ETIPlayer::ETIPlayer(bool pcm_output, bool unpaced, ETIPlayerObserver *observer, const ETI_PIPELINE_CONFIG& pipeline) {
+	AudioOutput *out;
 #ifndef DABLIN_DISABLE_SDL
 	if(!pcm_output)
 		out = new SDLOutput;
 	else
 #endif
 		out = new PCMOutput;
+
+	Init(observer, unpaced, out, pipeline);
+}
+
+ETIPlayer::ETIPlayer(AudioOutput *out, ETIPlayerObserver *observer) {
+	// the output is not a real-time device
+	Init(observer, true, out, ETI_PIPELINE_CONFIG());
+}
+
+void ETIPlayer::Init(ETIPlayerObserver *observer, bool unpaced, AudioOutput *out, const ETI_PIPELINE_CONFIG& pipeline) {
+	this->observer = observer;
+	this->unpaced = unpaced;
+	this->out = out;
+	this->pipeline = pipeline;
+
+	frame_count = 0;
+	next_frame_time = std::chrono::steady_clock::now();
+
+	dec = NULL;
+	passthrough_format = PASSTHROUGH_NONE;
+
+	frame_queue = NULL;
+	subchannel_queue = NULL;
+	audio_queue = NULL;
+	if(!pipeline.IsNone())
+		StartPipeline();
 }
 
 ETIPlayer::~ETIPlayer() {
+	StopPipeline();
+
 	delete dec;
 	delete out;
 }
 
+void ETIPlayer::StartPipeline() {
+	fprintf(stderr, "ETIPlayer: using pipeline with queue lengths %zu/%zu/%zu (%s, if full)\n",
+			pipeline.frame_queue_len,
+			pipeline.subchannel_queue_len,
+			pipeline.audio_queue_len,
+			pipeline.drop_when_full ? "drop" : "wait");
+
+	frame_queue = new SPSCQueue<ETI_PIPELINE_FRAME>(pipeline.frame_queue_len);
+	subchannel_queue = new SPSCQueue<ETI_PIPELINE_SUBCHANNEL>(pipeline.subchannel_queue_len);
+	audio_queue = new SPSCQueue<ETI_PIPELINE_AUDIO>(pipeline.audio_queue_len);
+
+	demux_thread = std::thread(&ETIPlayer::DemuxLoop, this);
+	decode_thread = std::thread(&ETIPlayer::DecodeLoop, this);
+	output_thread = std::thread(&ETIPlayer::OutputLoop, this);
+}
+
+void ETIPlayer::StopPipeline() {
+	if(!frame_queue)
+		return;
+
+	frame_queue->Abort();
+	subchannel_queue->Abort();
+	audio_queue->Abort();
+
+	demux_thread.join();
+	decode_thread.join();
+	output_thread.join();
+
+	delete frame_queue;
+	delete subchannel_queue;
+	delete audio_queue;
+	frame_queue = NULL;
+	subchannel_queue = NULL;
+	audio_queue = NULL;
+}
+
+void ETIPlayer::Flush() {
+	if(!frame_queue)
+		return;
+
+	// wait until all stages processed the pending data
+	frame_queue->WaitEmpty();
+	subchannel_queue->WaitEmpty();
+	audio_queue->WaitEmpty();
+}
+
+template<typename T>
+T* ETIPlayer::GetQueueItem(SPSCQueue<T> *queue, bool may_drop, const char *content) {
+	T *item = queue->WriteItem();
+	if(item)
+		return item;
+
+	if(may_drop && pipeline.drop_when_full) {
+		fprintf(stderr, "ETIPlayer: dropped %s due to full queue\n", content);
+		return NULL;
+	}
+
+	// apply backpressure
+	if(!queue->WaitWritable())
+		return NULL;
+	return queue->WriteItem();
+}
+
+void ETIPlayer::DemuxLoop() {
+	while(frame_queue->WaitReadable()) {
+		ETI_PIPELINE_FRAME *frame = frame_queue->ReadItem();
+
+		// announce sub-channel change to the decoder (also if no new sub-channel)
+		if(frame->audio_service != audio_service_demux) {
+			audio_service_demux = frame->audio_service;
+			FeedSubchannel(audio_service_demux, NULL, 0);
+		}
+
+		DecodeFrame(frame->data, frame->audio_service);
+		frame_queue->Release();
+	}
+}
+
+void ETIPlayer::DecodeLoop() {
+	while(subchannel_queue->WaitReadable()) {
+		ETI_PIPELINE_SUBCHANNEL *subchannel = subchannel_queue->ReadItem();
+
+		if(subchannel->audio_service != audio_service_decode) {
+			audio_service_decode = subchannel->audio_service;
+			ChangeDecoder(audio_service_decode);
+		}
+
+		if(dec && subchannel->len)
+			dec->Feed(subchannel->data, subchannel->len);
+		subchannel_queue->Release();
+	}
+}
+
+void ETIPlayer::OutputLoop() {
+	while(audio_queue->WaitReadable()) {
+		ETI_PIPELINE_AUDIO *audio = audio_queue->ReadItem();
+
+		if(audio->start)
+			out->StartAudio(audio->samplerate, audio->channels, audio->float32);
+		else
+			out->PutAudio(audio->data, audio->len);
+		audio_queue->Release();
+	}
+}
+
 bool ETIPlayer::IsSameAudioService(const AUDIO_SERVICE& audio_service) {
 	std::lock_guard<std::mutex> lock(status_mutex);
 
@@ -68,95 +306,103 @@ void ETIPlayer::ProcessFrame(const uint8_t *data) {
 		std::lock_guard<std::mutex> lock(status_mutex);
 
 		if(audio_service_now != audio_service_next) {
-			// cleanup
-			if(dec) {
-//					out->StopAudio();
-				delete dec;
-				dec = NULL;
-			}
-
 			audio_service_now = audio_service_next;
 
-			observer->ETIResetPAD();
-
-			// append
-			if(!audio_service_now.IsNone()) {
-				if(audio_service_now.dab_plus)
-					dec = new SuperframeFilter(this);
-				else
-					dec = new MP2Decoder(this);
-			}
+			// if pipelined, the decoder thread switches on its own
+			if(!frame_queue)
+				ChangeDecoder(audio_service_now);
 		}
 	}
 
-	// flow control
-	std::this_thread::sleep_until(next_frame_time);
-	next_frame_time += std::chrono::milliseconds(24);
-
-	DecodeFrame(data);
-}
+	// flow control (not needed, if decoding as fast as possible)
+	if(unpaced) {
+		if(frame_count == 0)
+			first_frame_time = std::chrono::steady_clock::now();
+	} else {
+		std::this_thread::sleep_until(next_frame_time);
+		next_frame_time += std::chrono::milliseconds(24);
+	}
+	frame_count++;
 
-void ETIPlayer::DecodeFrame(const uint8_t *eti_frame) {
-	// ERR
-	if(eti_frame[0] != 0xFF) {
-		fprintf(stderr, "ETIPlayer: ignored ETI frame with ERR = 0x%02X\n", eti_frame[0]);
+	if(!frame_queue) {
+		DecodeFrame(data, audio_service_now);
 		return;
 	}
 
-	uint32_t fsync = eti_frame[1] << 16 | eti_frame[2] << 8 | eti_frame[3];
-	if(fsync != 0x073AB6 && fsync != 0xF8C549) {
-		fprintf(stderr, "ETIPlayer: ignored ETI frame with FSYNC = 0x%06X\n", fsync);
+	ETI_PIPELINE_FRAME *frame = GetQueueItem(frame_queue, true, "ETI frame");
+	if(!frame)
 		return;
+	frame->audio_service = audio_service_now;
+	memcpy(frame->data, data, sizeof(frame->data));
+	frame_queue->Commit();
+}
+
+void ETIPlayer::ChangeDecoder(const AUDIO_SERVICE& audio_service) {
+	// cleanup
+	if(dec) {
+//		out->StopAudio();
+		delete dec;
+		dec = NULL;
 	}
 
-	bool ficf = eti_frame[5] & 0x80;
-	int nst = eti_frame[5] & 0x7F;
-	int mid = (eti_frame[6] & 0x18) >> 3;
-//	int fl = (eti_frame[6] & 0x07) << 8 | eti_frame[7];
+	observer->ETIResetPAD();
 
-	// check header CRC
-	size_t header_crc_data_len = 4 + nst * 4 + 2;
-	uint16_t header_crc_stored = eti_frame[4 + header_crc_data_len] << 8 | eti_frame[4 + header_crc_data_len + 1];
-	uint16_t header_crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(eti_frame + 4, header_crc_data_len);
-	if(header_crc_stored != header_crc_calced) {
-		fprintf(stderr, "ETIPlayer: ignored ETI frame due to wrong header CRC\n");
-		return;
+	// append
+	if(!audio_service.IsNone()) {
+		if(audio_service.dab_plus)
+			dec = new SuperframeFilter(this, passthrough_format);
+		else if(passthrough_format != PASSTHROUGH_NONE)
+			dec = new MP2Passthrough(this);
+		else
+			dec = new MP2Decoder(this);
 	}
+}
 
-	int ficl = ficf ? (mid == 3 ? 32 : 24) : 0;
-
-	int subch_bytes = 0;
-	int subch_offset = 8 + nst * 4 + 4;
+void ETIPlayer::PrintSpeed() {
+	if(frame_count == 0)
+		return;
 
-	if(ficl) {
-		ProcessFIC(eti_frame + subch_offset, ficl * 4);
-		subch_offset += ficl * 4;
-	}
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - first_frame_time).count();
+	double fps = duration > 0 ? frame_count / duration : 0;
+	fprintf(stderr, "ETIPlayer: processed %zu frames in %.3f s (%.1f frames/s = %.1fx real-time)\n", frame_count, duration, fps, fps * 0.024);
+}
 
-	// abort here, if ATM no sub-channel selected
-	if(audio_service_now.IsNone())
+void ETIPlayer::DecodeFrame(const uint8_t *eti_frame, const AUDIO_SERVICE& audio_service) {
+	if(!parser.Parse(eti_frame))
 		return;
 
-	for(int i = 0; i < nst; i++) {
-		int scid = (eti_frame[8 + i*4] & 0xFC) >> 2;
-		int stl = (eti_frame[8 + i*4 + 2] & 0x03) << 8 | eti_frame[8 + i*4 + 3];
+	size_t fic_len;
+	const uint8_t *fic_data = parser.GetFIC(fic_len);
+	if(fic_data)
+		ProcessFIC(fic_data, fic_len);
 
-		if(scid == audio_service_now.subchid) {
-			subch_bytes = stl * 8;
-			break;
-		} else {
-			subch_offset += stl * 8;
-		}
-	}
-	if(subch_bytes == 0) {
-		fprintf(stderr, "ETIPlayer: ignored ETI frame without sub-channel %d\n", audio_service_now.subchid);
+	// abort here, if ATM no sub-channel selected (or no usable one)
+	if(audio_service.IsNone() || !parser.IsBodyUsable())
+		return;
+
+	ETI_SUBCHANNEL subchannel = parser.GetSubchannel(audio_service.subchid);
+	if(subchannel.IsNone()) {
+		fprintf(stderr, "ETIPlayer: ignored ETI frame without sub-channel %d\n", audio_service.subchid);
 		return;
 	}
 
-	// TODO: check body CRC?
+	FeedSubchannel(audio_service, subchannel.data, subchannel.len);
+}
 
+void ETIPlayer::FeedSubchannel(const AUDIO_SERVICE& audio_service, const uint8_t *data, size_t len) {
+	if(!subchannel_queue) {
+		dec->Feed(data, len);
+		return;
+	}
 
-	dec->Feed(eti_frame + subch_offset, subch_bytes);
+	ETI_PIPELINE_SUBCHANNEL *subchannel = GetQueueItem(subchannel_queue, len != 0, "sub-channel data");
+	if(!subchannel)
+		return;
+	subchannel->audio_service = audio_service;
+	subchannel->len = len;
+	if(len)
+		memcpy(subchannel->data, data, len);
+	subchannel_queue->Commit();
 }
 
 void ETIPlayer::FormatChange(const std::string& format) {
@@ -165,6 +411,45 @@ void ETIPlayer::FormatChange(const std::string& format) {
 		observer->ETIChangeFormat(format);
 }
 
+void ETIPlayer::StartAudio(int samplerate, int channels, bool float32) {
+	if(!audio_queue) {
+		out->StartAudio(samplerate, channels, float32);
+		return;
+	}
+
+	// a format change must never be dropped
+	ETI_PIPELINE_AUDIO *audio = GetQueueItem(audio_queue, false, "audio format");
+	if(!audio)
+		return;
+	audio->start = true;
+	audio->samplerate = samplerate;
+	audio->channels = channels;
+	audio->float32 = float32;
+	audio->len = 0;
+	audio_queue->Commit();
+}
+
+void ETIPlayer::PutAudio(const uint8_t *data, size_t len) {
+	if(!audio_queue) {
+		out->PutAudio(data, len);
+		return;
+	}
+
+	while(len) {
+		ETI_PIPELINE_AUDIO *audio = GetQueueItem(audio_queue, true, "audio");
+		if(!audio)
+			return;
+		size_t chunk_len = std::min(len, sizeof(audio->data));
+		audio->start = false;
+		audio->len = chunk_len;
+		memcpy(audio->data, data, chunk_len);
+		audio_queue->Commit();
+
+		data += chunk_len;
+		len -= chunk_len;
+	}
+}
+
 void ETIPlayer::ProcessFIC(const uint8_t *data, size_t len) {
 //	fprintf(stderr, "Received %zu bytes FIC\n", len);
 	if(observer)
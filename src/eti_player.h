@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -29,6 +30,7 @@
 #include "dab_decoder.h"
 #include "dabplus_decoder.h"
 #include "pcm_output.h"
+#include "spsc_queue.h"
 #include "tools.h"
 
 #ifndef DABLIN_DISABLE_SDL
@@ -36,6 +38,105 @@
 #endif
 
 
+// --- ETI_SUBCHANNEL -----------------------------------------------------------------
+struct ETI_SUBCHANNEL {
+	const uint8_t *data;
+	size_t len;
+
+	bool IsNone() const {return len == 0;}
+
+	ETI_SUBCHANNEL() : data(NULL), len(0) {}
+	ETI_SUBCHANNEL(const uint8_t *data, size_t len) : data(data), len(len) {}
+};
+
+struct ETI_SUBCHANNEL_SLICE {
+	size_t offset;
+	size_t len;
+
+	ETI_SUBCHANNEL_SLICE() : offset(0), len(0) {}
+};
+
+
+// --- ETIFrameParser -----------------------------------------------------------------
+class ETIFrameParser {
+private:
+	// stream characterisation the slices were derived from (FICF/NST, MID/FL, STC)
+	uint8_t stc_key[3 + 127 * 4];
+	size_t stc_key_len;
+
+	const uint8_t *eti_frame;
+	size_t fic_offset;
+	size_t fic_len;
+	size_t mst_offset;
+	size_t mst_len;
+	ETI_SUBCHANNEL_SLICE slices[64];
+
+	bool strict_body_crc;
+	bool body_crc_ok;
+	std::atomic<size_t> body_crc_errors;
+
+	bool CheckHeaderCRC(int nst);
+	bool UpdateSlices(int nst);
+	void CheckBodyCRC();
+public:
+	ETIFrameParser() : stc_key_len(0), eti_frame(NULL), fic_offset(0), fic_len(0), mst_offset(0), mst_len(0), strict_body_crc(false), body_crc_ok(false), body_crc_errors(0) {}
+
+	bool Parse(const uint8_t *eti_frame);
+	void SetStrictBodyCRC(bool strict_body_crc) {this->strict_body_crc = strict_body_crc;}
+	bool IsBodyUsable() const {return body_crc_ok || !strict_body_crc;}
+	size_t GetBodyCRCErrors() const {return body_crc_errors;}
+
+	const uint8_t* GetFIC(size_t& len) const {len = fic_len; return fic_len ? eti_frame + fic_offset : NULL;}
+	const ETI_SUBCHANNEL_SLICE* GetSlices() const {return slices;}
+	ETI_SUBCHANNEL GetSubchannel(int subchid) const {
+		if(subchid < 0 || subchid >= 64 || slices[subchid].len == 0)
+			return ETI_SUBCHANNEL();
+		return ETI_SUBCHANNEL(eti_frame + slices[subchid].offset, slices[subchid].len);
+	}
+
+	static const size_t eti_frame_len = 6144;
+};
+
+
+// --- ETI_PIPELINE_CONFIG -----------------------------------------------------------------
+struct ETI_PIPELINE_CONFIG {
+	size_t frame_queue_len;			// reader -> demux
+	size_t subchannel_queue_len;	// demux -> decoder
+	size_t audio_queue_len;			// decoder -> output
+	bool drop_when_full;			// drop (instead of waiting), if the next stage is too slow
+
+	bool IsNone() const {return frame_queue_len == 0 || subchannel_queue_len == 0 || audio_queue_len == 0;}
+
+	ETI_PIPELINE_CONFIG() : frame_queue_len(0), subchannel_queue_len(0), audio_queue_len(0), drop_when_full(false) {}
+	ETI_PIPELINE_CONFIG(size_t frame_queue_len, size_t subchannel_queue_len, size_t audio_queue_len, bool drop_when_full) :
+		frame_queue_len(frame_queue_len),
+		subchannel_queue_len(subchannel_queue_len),
+		audio_queue_len(audio_queue_len),
+		drop_when_full(drop_when_full)
+	{}
+};
+
+struct ETI_PIPELINE_FRAME {
+	AUDIO_SERVICE audio_service;
+	uint8_t data[6144];
+};
+
+struct ETI_PIPELINE_SUBCHANNEL {
+	AUDIO_SERVICE audio_service;
+	size_t len;
+	uint8_t data[1023 * 8];
+};
+
+struct ETI_PIPELINE_AUDIO {
+	bool start;
+	int samplerate;
+	int channels;
+	bool float32;
+	size_t len;
+	uint8_t data[16384];
+};
+
+
 // --- ETIPlayerObserver -----------------------------------------------------------------
 class ETIPlayerObserver {
 public:
@@ -53,27 +154,59 @@ class ETIPlayer : SubchannelSinkObserver {
 private:
 	ETIPlayerObserver *observer;
 
+	bool unpaced;
+	size_t frame_count;
+	std::chrono::steady_clock::time_point first_frame_time;
 	std::chrono::steady_clock::time_point next_frame_time;
 
 	std::mutex status_mutex;
 	AUDIO_SERVICE audio_service_now;
 	AUDIO_SERVICE audio_service_next;
 
+	ETIFrameParser parser;
 	SubchannelSink *dec;
 	AudioOutput *out;
-
-	void DecodeFrame(const uint8_t *eti_frame);
+	PASSTHROUGH_FORMAT passthrough_format;
+
+	// pipeline (if used)
+	ETI_PIPELINE_CONFIG pipeline;
+	SPSCQueue<ETI_PIPELINE_FRAME> *frame_queue;
+	SPSCQueue<ETI_PIPELINE_SUBCHANNEL> *subchannel_queue;
+	SPSCQueue<ETI_PIPELINE_AUDIO> *audio_queue;
+	std::thread demux_thread;
+	std::thread decode_thread;
+	std::thread output_thread;
+	AUDIO_SERVICE audio_service_demux;
+	AUDIO_SERVICE audio_service_decode;
+
+	void Init(ETIPlayerObserver *observer, bool unpaced, AudioOutput *out, const ETI_PIPELINE_CONFIG& pipeline);
+	void StartPipeline();
+	void StopPipeline();
+	template<typename T> T* GetQueueItem(SPSCQueue<T> *queue, bool may_drop, const char *content);
+	void DemuxLoop();
+	void DecodeLoop();
+	void OutputLoop();
+
+	void ChangeDecoder(const AUDIO_SERVICE& audio_service);
+	void DecodeFrame(const uint8_t *eti_frame, const AUDIO_SERVICE& audio_service);
+	void FeedSubchannel(const AUDIO_SERVICE& audio_service, const uint8_t *data, size_t len);
 
 	void FormatChange(const std::string& format);
-	void StartAudio(int samplerate, int channels, bool float32) {out->StartAudio(samplerate, channels, float32);}
-	void PutAudio(const uint8_t *data, size_t len) {out->PutAudio(data, len);}
+	void StartAudio(int samplerate, int channels, bool float32);
+	void PutAudio(const uint8_t *data, size_t len);
 	void ProcessFIC(const uint8_t *data, size_t len);
 	void ProcessPAD(const uint8_t *xpad_data, size_t xpad_len, bool exact_xpad_len, const uint8_t *fpad_data);
 public:
-	ETIPlayer(bool pcm_output, ETIPlayerObserver *observer);
+	ETIPlayer(bool pcm_output, bool unpaced, ETIPlayerObserver *observer, const ETI_PIPELINE_CONFIG& pipeline = ETI_PIPELINE_CONFIG());
+	ETIPlayer(AudioOutput *out, ETIPlayerObserver *observer);
 	~ETIPlayer();
 
 	void ProcessFrame(const uint8_t *data);
+	void Flush();
+	void SetStrictBodyCRC(bool strict_body_crc) {parser.SetStrictBodyCRC(strict_body_crc);}
+	void SetPassthrough(PASSTHROUGH_FORMAT passthrough_format) {this->passthrough_format = passthrough_format;}
+	size_t GetBodyCRCErrors() const {return parser.GetBodyCRCErrors();}
+	void PrintSpeed();
 
 	bool IsSameAudioService(const AUDIO_SERVICE& audio_service);
 	void SetAudioService(const AUDIO_SERVICE& audio_service);
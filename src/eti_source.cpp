@@ -20,28 +20,64 @@
 
 
 // --- ETISource -----------------------------------------------------------------
+const size_t ETISource::map_readahead_len;
+
 ETISource::ETISource(std::string filename, ETISourceObserver *observer) {
 	this->filename = filename;
 	this->observer = observer;
 
 	input_file = NULL;
+	tail = false;
+	inotify_initialized = false;
+	inotify_fd = -1;
+	inotify_watching = false;
+
+	input_map = NULL;
+	input_map_len = 0;
+	input_map_mapped_len = 0;
+	input_map_start = 0;
+	input_map_offset = 0;
+	input_map_advised = 0;
+	index = NULL;
+
+	stream_ring = NULL;
+	stream_ring_read = 0;
+	stream_ring_write = 0;
+
 	eti_frame_count = 0;
 	eti_frame_total = 0;
 	eti_progress_next_ms = 0;
 
 	do_exit = false;
+	seek_requested = false;
+	seek_frame = 0;
 }
 
 ETISource::~ETISource() {
 	// cleanup
+	delete index;
+	UnmapFile();
+	if(inotify_fd != -1)
+		close(inotify_fd);
 	if(input_file && input_file != stdin)
 		fclose(input_file);
+	delete[] stream_ring;
 }
 
 void ETISource::DoExit() {
-	std::lock_guard<std::mutex> lock(status_mutex);
-
+	// (also called from signal handlers)
 	do_exit = true;
+	event_loop.Wakeup();
+}
+
+void ETISource::Seek(size_t frame) {
+	{
+		std::lock_guard<std::mutex> lock(status_mutex);
+
+		seek_frame = frame;
+		seek_requested = true;
+	}
+	event_loop.Wakeup();
 }
 
 void ETISource::PrintSource() {
@@ -66,43 +102,264 @@ bool ETISource::OpenFile() {
 
 bool ETISource::UpdateTotalFrames() {
 	// if file size available, calc total frame count
-	off_t old_offset = ftello(input_file);
-	if(old_offset == -1) {
-		// ignore non-seekable files (like usually stdin)
-		if(errno == ESPIPE)
-			return true;
+	struct stat file_stat;
+	if(fstat(fileno(input_file), &file_stat)) {
+		perror("ETISource: error getting file status");
+		return false;
+	}
+
+	// ignore non-regular files (like usually stdin)
+	if(!S_ISREG(file_stat.st_mode))
+		return true;
+
+	size_t len = file_stat.st_size;
+	eti_frame_total = len >= eti_frame_len ? (len / eti_frame_len) - 1 : 0;
+	return true;
+}
+
+int ETISource::Main() {
+	if(!input_file) {
+		if(!OpenFile())
+			return 1;
+	}
+
+	PrintSource();
+
+	// use zero-copy access for regular files; pipes (like stdin or a live source) are read as stream
+	if(MapFile()) {
+		// recordings (but not stdin or files still being written) get a frame index for seeking
+		if(input_file != stdin && input_map_start == 0 && !tail) {
+			index = new ETIFrameIndex(filename);
+			index->Start();
+		}
+		return MainMapped();
+	}
+	return MainStream();
+}
+
+bool ETISource::MapFile() {
+	int file_no = fileno(input_file);
+
+	// only regular files can be mapped
+	struct stat file_stat;
+	if(fstat(file_no, &file_stat)) {
+		perror("ETISource: error getting file status");
+		return false;
+	}
+	if(!S_ISREG(file_stat.st_mode))
+		return false;
+
+	// start at the current offset (e.g. if stdin is redirected from a file)
+	off_t offset = lseek(file_no, 0, SEEK_CUR);
+	if(offset == -1) {
 		perror("ETISource: error getting file offset");
 		return false;
 	}
 
-	if(fseeko(input_file, 0, SEEK_END)) {
-		perror("ETISource: error seeking to end");
+	// nothing to map (yet) - unless waiting for the file to grow anyway
+	if(file_stat.st_size <= offset && !tail)
+		return false;
+
+	input_map_start = input_map_offset = offset;
+	if(!RemapFile())
 		return false;
+
+	posix_fadvise(file_no, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return true;
+}
+
+bool ETISource::RemapFile() {
+	struct stat file_stat;
+	if(fstat(fileno(input_file), &file_stat)) {
+		perror("ETISource: error getting file status");
+		return false;
+	}
+
+	size_t len = file_stat.st_size;
+	eti_frame_total = len >= eti_frame_len ? (len / eti_frame_len) - 1 : 0;
+
+	// remap only, if the file has grown beyond the mapping meanwhile
+	if(input_map && len <= input_map_mapped_len) {
+		input_map_len = std::max(input_map_len, len);
+		return true;
 	}
 
-	off_t len = ftello(input_file);
-	if(len == -1) {
-		perror("ETISource: error getting file size");
+	/* When following a file which is still being written, the mapping
+	 * reserves some space beyond the file end. The pages there become
+	 * accessible as soon as the file grows, so that the file has not to be
+	 * remapped for every appended frame.
+	 */
+	size_t mapped_len = tail ? len + map_reserve_len : len;
+	void *map = mmap(NULL, mapped_len, PROT_READ, MAP_SHARED, fileno(input_file), 0);
+	if(map == MAP_FAILED) {
+		perror("ETISource: error mapping input file");
 		return false;
 	}
+	if(madvise(map, mapped_len, MADV_SEQUENTIAL))
+		perror("ETISource: error advising sequential access");
+
+	UnmapFile();
+	input_map = (const uint8_t*) map;
+	input_map_len = len;
+	input_map_mapped_len = mapped_len;
+	input_map_advised = input_map_offset;
+	return true;
+}
+
+void ETISource::UnmapFile() {
+	if(!input_map)
+		return;
+
+	if(munmap((void*) input_map, input_map_mapped_len))
+		perror("ETISource: error unmapping input file");
+	input_map = NULL;
+	input_map_len = 0;
+	input_map_mapped_len = 0;
+}
 
-	if(fseeko(input_file, old_offset, SEEK_SET)) {
-		perror("ETISource: error seeking to offset");
+bool ETISource::WaitForGrowth() {
+	// block until the file was modified (or an exit/seek request wakes us up)
+	if(!inotify_initialized) {
+		inotify_initialized = true;
+
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if(inotify_fd == -1)
+			perror("ETISource: error initializing inotify");
+		else if(inotify_add_watch(inotify_fd, filename.c_str(), IN_MODIFY | IN_CLOSE_WRITE) == -1)
+			perror("ETISource: error watching input file");
+		else
+			inotify_watching = event_loop.Add(inotify_fd, event_id_inotify);
+
+		// the file may have grown before the watch was added
+		return true;
+	}
+
+	// without inotify, the file size has to be checked periodically
+	std::vector<int> ready_ids;
+	if(event_loop.Wait(ready_ids, inotify_watching ? -1 : 100) == -1)
 		return false;
+
+	// discard the events (only the new file size matters)
+	if(inotify_watching && !ready_ids.empty()) {
+		uint8_t events[4096];
+		while(read(inotify_fd, events, sizeof(events)) > 0);
 	}
+	return true;
+}
 
-	eti_frame_total = (len / sizeof(eti_frame)) - 1;
+bool ETISource::UpdateProgress() {
+	// if present, update progress every 500ms or at file end
+	if(eti_frame_total && (eti_frame_count * 24 >= eti_progress_next_ms || eti_frame_count == eti_frame_total)) {
+		// update total frames
+		if(!(input_map ? RemapFile() : UpdateTotalFrames()))
+			return false;
+
+		ETI_PROGRESS progress;
+		progress.value = (double) eti_frame_count / (double) eti_frame_total;
+		progress.text = FramecountToTimecode(eti_frame_count) + " / " + FramecountToTimecode(eti_frame_total);
+		progress.frames_total = eti_frame_total;
+		observer->ETIUpdateProgress(progress);
+
+		eti_progress_next_ms += 500;
+	}
 	return true;
 }
 
-int ETISource::Main() {
-	if(!input_file) {
-		if(!OpenFile())
+void ETISource::SeekMapped(size_t frame) {
+	// the file may have grown meanwhile
+	if(!RemapFile())
+		return;
+
+	size_t frames = (input_map_len - input_map_start) / eti_frame_len;
+	if(frames == 0)
+		return;
+	frame = std::min(frame, frames - 1);
+
+	fprintf(stderr, "ETISource: seeking to %s\n", FramecountToTimecode(frame).c_str());
+
+	input_map_offset = input_map_start + frame * eti_frame_len;
+	input_map_advised = input_map_offset;
+	eti_frame_count = frame;
+	eti_progress_next_ms = frame * 24;
+
+	// restore the FIC state from the last snapshot before the target (if already indexed)
+	ETI_INDEX_ENTRY entry;
+	if(index && index->GetEntry(frame, entry) && !entry.figs.empty()) {
+		std::vector<uint8_t> fic;
+		ETIFrameIndex::FIGsToFIC(entry.figs, fic);
+		observer->ETIRestoreFIC(&fic[0], fic.size());
+	}
+}
+
+int ETISource::MainMapped() {
+	const size_t page_mask = sysconf(_SC_PAGESIZE) - 1;
+
+	for(;;) {
+		if(do_exit)
+			break;
+
+		if(seek_requested) {
+			size_t seek_target;
+			{
+				std::lock_guard<std::mutex> lock(status_mutex);
+
+				seek_target = seek_frame;
+				seek_requested = false;
+			}
+			SeekMapped(seek_target);
+		}
+
+		if(input_map_offset + eti_frame_len > input_map_len) {
+			// check, if the file has grown meanwhile
+			if(!RemapFile())
+				return 1;
+			if(input_map_offset + eti_frame_len > input_map_len) {
+				if(!tail) {
+					fprintf(stderr, "ETISource: EOF reached!\n");
+					break;
+				}
+
+				// wait for further frames of the file being written
+				if(!WaitForGrowth())
+					return 1;
+				continue;
+			}
+		}
+
+		// request readahead of the upcoming frames (at half of the previous window)
+		if(input_map_offset >= input_map_advised) {
+			size_t advise_start = input_map_offset & ~page_mask;
+			size_t advise_len = std::min(map_readahead_len, input_map_len - advise_start);
+			madvise((void*) (input_map + advise_start), advise_len, MADV_WILLNEED);
+			input_map_advised = input_map_offset + map_readahead_len / 2;
+		}
+
+		if(!UpdateProgress())
 			return 1;
+
+		// the progress update may have remapped the file
+		observer->ETIProcessFrame(input_map + input_map_offset);
+		eti_frame_count++;
+		input_map_offset += eti_frame_len;
 	}
 
-	PrintSource();
+	return 0;
+}
+
+void ETISource::EnlargePipe(int file_no) {
+#ifdef F_SETPIPE_SZ
+	// a larger pipe allows the producer to write ahead while we are busy (ignoring non-pipes)
+	int pipe_size = fcntl(file_no, F_GETPIPE_SZ);
+	if(pipe_size == -1 || pipe_size >= stream_pipe_size)
+		return;
+	if(fcntl(file_no, F_SETPIPE_SZ, stream_pipe_size) == -1)
+		perror("ETISource: error enlarging pipe");
+#else
+	(void) file_no;
+#endif
+}
 
+int ETISource::MainStream() {
 	int file_no = fileno(input_file);
 
 	// set non-blocking mode
@@ -116,67 +373,65 @@ int ETISource::Main() {
 		return 1;
 	}
 
-	fd_set fds;
-	timeval select_timeval;
-	size_t filled = 0;
+	EnlargePipe(file_no);
 
-	for(;;) {
-		{
-			std::lock_guard<std::mutex> lock(status_mutex);
+	/* Frames are read in large chunks into a ring of frame slots. As the ring
+	 * len is a multiple of the frame len, a frame never wraps around; so each
+	 * read fills up to the ring end and all complete frames are passed on in
+	 * place afterwards.
+	 */
+	const size_t stream_ring_len = stream_ring_slots * eti_frame_len;
+	if(!stream_ring)
+		stream_ring = new uint8_t[stream_ring_len];
+	stream_ring_read = stream_ring_write = 0;
 
-			if(do_exit)
-				break;
-		}
-
-		FD_ZERO(&fds);
-		FD_SET(file_no, &fds);
+	// sleep until data or an exit request arrives (regular files are always readable)
+	bool wait_for_input = event_loop.Add(file_no, event_id_input);
+	std::vector<int> ready_ids;
 
-		select_timeval.tv_sec = 0;
-		select_timeval.tv_usec = 100 * 1000;
+	for(;;) {
+		if(do_exit)
+			break;
 
-		int ready_fds = select(file_no + 1, &fds, NULL, NULL, &select_timeval);
-		if(ready_fds == -1) {
-			// ignore break request, as handled above
-			if(errno != EINTR)
-				perror("ETISource: error while select");
-			continue;
+		// streams cannot be rewound
+		if(seek_requested) {
+			fprintf(stderr, "ETISource: seeking is not possible within a stream\n");
+			seek_requested = false;
 		}
-		if(!(ready_fds && FD_ISSET(file_no, &fds)))
-			continue;
 
-		size_t bytes = fread(eti_frame + filled, 1, sizeof(eti_frame) - filled, input_file);
+		if(wait_for_input) {
+			if(event_loop.Wait(ready_ids) == -1)
+				return 1;
+			if(ready_ids.empty())
+				continue;
+		}
 
-		if(bytes > 0)
-			filled += bytes;
-		if(bytes == 0) {
-			if(feof(input_file)) {
-				fprintf(stderr, "ETISource: EOF reached!\n");
-				break;
-			}
-			perror("ETISource: error while fread");
+		ssize_t bytes = read(file_no, stream_ring + stream_ring_write, stream_ring_len - stream_ring_write);
+		if(bytes == -1) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				continue;
+			perror("ETISource: error while read");
 			return 1;
 		}
+		if(bytes == 0) {
+			fprintf(stderr, "ETISource: EOF reached!\n");
+			break;
+		}
+		stream_ring_write += bytes;
 
-		if(filled < sizeof(eti_frame))
-			continue;
-
-		// if present, update progress every 500ms or at file end
-		if(eti_frame_total && (eti_frame_count * 24 >= eti_progress_next_ms || eti_frame_count == eti_frame_total)) {
-			// update total frames
-			if(!UpdateTotalFrames())
+		// pass on all complete frames
+		while(stream_ring_write - stream_ring_read >= eti_frame_len) {
+			if(!UpdateProgress())
 				return 1;
 
-			ETI_PROGRESS progress;
-			progress.value = (double) eti_frame_count / (double) eti_frame_total;
-			progress.text = FramecountToTimecode(eti_frame_count) + " / " + FramecountToTimecode(eti_frame_total);
-			observer->ETIUpdateProgress(progress);
-
-			eti_progress_next_ms += 500;
+			observer->ETIProcessFrame(stream_ring + stream_ring_read);
+			eti_frame_count++;
+			stream_ring_read += eti_frame_len;
 		}
 
-		observer->ETIProcessFrame(eti_frame);
-		eti_frame_count++;
-		filled = 0;
+		// wrap around at the ring end (then no partial frame can be pending)
+		if(stream_ring_write == stream_ring_len)
+			stream_ring_read = stream_ring_write = 0;
 	}
 
 	return 0;
@@ -213,16 +468,30 @@ std::string ETISource::FramecountToTimecode(size_t value) {
 DABLiveETISource::DABLiveETISource(std::string binary, DAB_LIVE_SOURCE_CHANNEL channel, ETISourceObserver *observer) : ETISource("", observer) {
 	this->channel = channel;
 
-	// it doesn't matter whether there is a prefixed path or not
-	binary_name = binary.substr(binary.find_last_of('/') + 1);
-
-	std::string cmdline = binary + " " + std::to_string(channel.freq * 1000);
+	std::vector<std::string> args;
+	args.push_back(binary);
+	args.push_back(std::to_string(channel.freq * 1000));
 	if(!channel.HasAutoGain())
-		cmdline += " " + std::to_string(channel.gain);
-	
-	input_file = popen(cmdline.c_str(), "r");
+		args.push_back(std::to_string(channel.gain));
+
+	int output_fd = process.Start(args);
+	if(output_fd == -1) {
+		fprintf(stderr, "ETISource: error starting DAB live source\n");
+		return;
+	}
+
+	input_file = fdopen(output_fd, "r");
+	if(!input_file) {
+		perror("ETISource: error opening DAB live source output");
+		close(output_fd);
+	}
+}
+
+int DABLiveETISource::Main() {
+	// don't fall back to stdin
 	if(!input_file)
-		perror("ETISource: error starting DAB live source");
+		return 1;
+	return ETISource::Main();
 }
 
 void DABLiveETISource::PrintSource() {
@@ -230,12 +499,10 @@ void DABLiveETISource::PrintSource() {
 }
 
 DABLiveETISource::~DABLiveETISource() {
-	// TODO: replace bad style temporary solution (here possible, because dab2eti allows only one concurrent session)
-	std::string cmd_killall = "killall " + binary_name;
-	int result = system(cmd_killall.c_str());
-	if(result != 0)
-		fprintf(stderr, "ETISource: error killing DAB live source\n");
+	// stop only our own instance of the DAB live source
+	process.Stop();
 
-	pclose(input_file);
+	if(input_file)
+		fclose(input_file);
 	input_file = NULL;
 }
@@ -22,19 +22,29 @@
 // support 2GB+ files on 32bit systems
 #define _FILE_OFFSET_BITS 64
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <atomic>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "child_process.h"
+#include "event_loop.h"
+#include "eti_index.h"
 
 
 struct ETI_PROGRESS {
 	double value;
 	std::string text;
+	size_t frames_total;
 };
 
 struct DAB_LIVE_SOURCE_CHANNEL {
@@ -61,6 +71,7 @@ public:
 
 	virtual void ETIProcessFrame(const uint8_t* /*data*/) {};
 	virtual void ETIUpdateProgress(const ETI_PROGRESS /*progress*/) {};
+	virtual void ETIRestoreFIC(const uint8_t* /*data*/, size_t /*len*/) {};
 };
 
 
@@ -70,27 +81,65 @@ protected:
 	std::string filename;
 	ETISourceObserver *observer;
 
+	EventLoop event_loop;
+	std::atomic<bool> do_exit;
+	std::atomic<bool> seek_requested;
 	std::mutex status_mutex;
-	bool do_exit;
+	size_t seek_frame;
 
 	FILE *input_file;
+	bool tail;
+	bool inotify_initialized;
+	int inotify_fd;
+	bool inotify_watching;
+
+	const uint8_t *input_map;
+	size_t input_map_len;
+	size_t input_map_mapped_len;
+	size_t input_map_start;
+	size_t input_map_offset;
+	size_t input_map_advised;
+	ETIFrameIndex *index;
+
+	uint8_t *stream_ring;
+	size_t stream_ring_read;
+	size_t stream_ring_write;
 
-	uint8_t eti_frame[6144];
 	size_t eti_frame_count;
 	size_t eti_frame_total;
 	unsigned long int eti_progress_next_ms;
 
 	bool OpenFile();
 	bool UpdateTotalFrames();
+	bool UpdateProgress();
 	virtual void PrintSource();
 
-	static std::string FramecountToTimecode(size_t value);
+	bool MapFile();
+	bool RemapFile();
+	void UnmapFile();
+	int MainMapped();
+	int MainStream();
+	void EnlargePipe(int file_no);
+	void SeekMapped(size_t frame);
+	bool WaitForGrowth();
+
+	static const size_t eti_frame_len = 6144;
+	static const size_t map_readahead_len = 64 * eti_frame_len;
+	static const size_t map_reserve_len = 4096 * eti_frame_len;
+	static const size_t stream_ring_slots = 32;
+	static const int stream_pipe_size = 1024 * 1024;
+	static const int event_id_input = 0;
+	static const int event_id_inotify = 1;
 public:
 	ETISource(std::string filename, ETISourceObserver *observer);
 	virtual ~ETISource();
 
-	int Main();
+	virtual int Main();
 	void DoExit();
+	void Seek(size_t frame);
+	void SetTail(bool tail) {this->tail = tail;}
+
+	static std::string FramecountToTimecode(size_t value);
 };
 
 
@@ -98,12 +147,14 @@ public:
 class DABLiveETISource : public ETISource {
 private:
 	DAB_LIVE_SOURCE_CHANNEL channel;
-	std::string binary_name;
+	ChildProcess process;
 
 	void PrintSource();
 public:
 	DABLiveETISource(std::string binary, DAB_LIVE_SOURCE_CHANNEL channel, ETISourceObserver *observer);
 	~DABLiveETISource();
+
+	int Main();
 };
 
 
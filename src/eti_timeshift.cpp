@@ -0,0 +1,263 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_timeshift.h"
+
+
+// --- ETITimeshift -----------------------------------------------------------------
+ETITimeshift::ETITimeshift(ETISourceObserver *observer, size_t window_frames) : write_count(0) {
+	this->observer = observer;
+
+	// the window shall exceed the hot ring
+	this->window_frames = std::max(window_frames, 2 * hot_ring_frames);
+
+	ring_fd = -1;
+	ring_map = NULL;
+	hot_ring = NULL;
+
+	do_exit = false;
+	paused = false;
+	reset_pacing = true;
+	read_count = 0;
+}
+
+ETITimeshift::~ETITimeshift() {
+	DoExit();
+	if(reader_thread.joinable())
+		reader_thread.join();
+
+	if(ring_map && munmap(ring_map, window_frames * eti_frame_len))
+		perror("ETITimeshift: error unmapping ring file");
+	if(ring_fd != -1)
+		close(ring_fd);
+	delete[] hot_ring;
+}
+
+bool ETITimeshift::Open() {
+	// the ring shall reside on disk, so avoid /tmp (often tmpfs i.e. RAM) by default
+	const char *tmp_dir = getenv("TMPDIR");
+	std::string ring_filename = std::string(tmp_dir ? tmp_dir : "/var/tmp") + "/dablin_timeshift_XXXXXX";
+
+	ring_fd = mkstemp(&ring_filename[0]);
+	if(ring_fd == -1) {
+		perror("ETITimeshift: error creating ring file");
+		return false;
+	}
+
+	// the ring file is only needed as long as it is open
+	if(unlink(ring_filename.c_str()))
+		perror("ETITimeshift: error unlinking ring file");
+
+	// allocate the whole ring at once, so that writing into the mapping cannot fail later
+	size_t ring_len = window_frames * eti_frame_len;
+	int result = posix_fallocate(ring_fd, 0, ring_len);
+	if(result) {
+		fprintf(stderr, "ETITimeshift: error allocating ring file: %s\n", strerror(result));
+		return false;
+	}
+
+	void *map = mmap(NULL, ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+	if(map == MAP_FAILED) {
+		perror("ETITimeshift: error mapping ring file");
+		return false;
+	}
+	ring_map = (uint8_t*) map;
+	hot_ring = new uint8_t[hot_ring_frames * eti_frame_len];
+
+	fprintf(stderr, "ETITimeshift: keeping the last %s in '%s'\n", ETISource::FramecountToTimecode(window_frames).c_str(), ring_filename.c_str());
+
+	reader_thread = std::thread(&ETITimeshift::ReaderLoop, this);
+	return true;
+}
+
+void ETITimeshift::DoExit() {
+	// (also called from signal handlers, so no locking; all waits time out periodically)
+	do_exit = true;
+}
+
+void ETITimeshift::Reset() {
+	// (only while no source is running)
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	write_count = 0;
+	read_count = 0;
+	reset_pacing = true;
+}
+
+void ETITimeshift::WaitCaughtUp() {
+	std::unique_lock<std::mutex> lock(status_mutex);
+
+	while(!do_exit && read_count < write_count)
+		status_cond.wait_for(lock, std::chrono::milliseconds(100));
+}
+
+void ETITimeshift::Pause(bool pause) {
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	paused = pause;
+	reset_pacing = true;
+	status_cond.notify_all();
+}
+
+bool ETITimeshift::IsPaused() {
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	return paused;
+}
+
+void ETITimeshift::Skip(int seconds) {
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	size_t frames_written = write_count;
+	size_t oldest = GetOldestFrame(frames_written);
+	size_t current = std::max(read_count, oldest);
+	long int frames = (long int) seconds * 1000 / 24;
+
+	if(frames < 0)
+		read_count = (size_t) -frames < current - oldest ? current + frames : oldest;
+	else
+		read_count = std::min(current + frames, frames_written);
+	reset_pacing = true;
+	status_cond.notify_all();
+}
+
+void ETITimeshift::Seek(size_t frame) {
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	size_t frames_written = write_count;
+	read_count = std::min(GetOldestFrame(frames_written) + frame, frames_written);
+	reset_pacing = true;
+	status_cond.notify_all();
+}
+
+void ETITimeshift::CatchUp() {
+	std::lock_guard<std::mutex> lock(status_mutex);
+
+	read_count = write_count;
+	reset_pacing = true;
+	status_cond.notify_all();
+}
+
+size_t ETITimeshift::GetOldestFrame(size_t frames_written) {
+	// the slot of the oldest frame may currently be overwritten
+	return frames_written >= window_frames ? frames_written - window_frames + 1 : 0;
+}
+
+void ETITimeshift::ETIProcessFrame(const uint8_t *data) {
+	size_t frame = write_count.load(std::memory_order_relaxed);
+
+	memcpy(ring_map + (frame % window_frames) * eti_frame_len, data, eti_frame_len);
+	memcpy(hot_ring + (frame % hot_ring_frames) * eti_frame_len, data, eti_frame_len);
+	write_count.store(frame + 1, std::memory_order_release);
+
+	// notify without lock, so that the writer never waits for the reader (which also wakes up periodically)
+	status_cond.notify_one();
+}
+
+bool ETITimeshift::ReadFrame(size_t frame, uint8_t *eti_frame) {
+	size_t frames_written = write_count.load(std::memory_order_acquire);
+	if(frame >= frames_written)
+		return false;
+
+	// prefer the hot ring, if the frame is still available there
+	bool hot = frames_written - frame < hot_ring_frames;
+	if(hot)
+		memcpy(eti_frame, hot_ring + (frame % hot_ring_frames) * eti_frame_len, eti_frame_len);
+	else
+		memcpy(eti_frame, ring_map + (frame % window_frames) * eti_frame_len, eti_frame_len);
+
+	// ensure that the slot was not overwritten meanwhile
+	std::atomic_thread_fence(std::memory_order_acquire);
+	frames_written = write_count.load(std::memory_order_relaxed);
+	return frame < frames_written && frames_written - frame < (hot ? hot_ring_frames : window_frames);
+}
+
+void ETITimeshift::UpdateProgress(size_t frame, size_t frames_written) {
+	size_t oldest = GetOldestFrame(frames_written);
+	bool is_paused;
+	{
+		std::lock_guard<std::mutex> lock(status_mutex);
+		is_paused = paused;
+	}
+
+	ETI_PROGRESS progress;
+	progress.frames_total = frames_written - oldest;
+	progress.value = progress.frames_total ? (double) (frame - oldest) / (double) progress.frames_total : 1.0;
+	progress.text = "-" + ETISource::FramecountToTimecode(frames_written - frame) + (is_paused ? " (paused)" : "         ");
+	observer->ETIUpdateProgress(progress);
+}
+
+void ETITimeshift::ReaderLoop() {
+	uint8_t eti_frame[eti_frame_len];
+	std::chrono::steady_clock::time_point next_frame_time;
+	std::chrono::steady_clock::time_point next_progress_time = std::chrono::steady_clock::now();
+
+	for(;;) {
+		size_t frame;
+		size_t frames_written;
+		bool frame_available;
+		{
+			std::unique_lock<std::mutex> lock(status_mutex);
+
+			// wait for a frame (as the writer notifies without lock, with timeout)
+			status_cond.wait_for(lock, std::chrono::milliseconds(100), [&]{return do_exit || (!paused && read_count < write_count);});
+			if(do_exit)
+				break;
+
+			// continue with the oldest frame, if fallen out of the window
+			frames_written = write_count;
+			read_count = std::max(read_count, GetOldestFrame(frames_written));
+			frame = read_count;
+
+			// after waiting/moving, pace from now on
+			frame_available = !paused && frame < frames_written;
+			if(!frame_available) {
+				reset_pacing = true;
+				status_cond.notify_all();
+			}
+			if(reset_pacing && frame_available) {
+				next_frame_time = std::chrono::steady_clock::now();
+				reset_pacing = false;
+			}
+		}
+
+		// update progress every 500ms
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if(now >= next_progress_time) {
+			UpdateProgress(frame, frames_written);
+			next_progress_time = now + std::chrono::milliseconds(500);
+		}
+
+		if(!frame_available || !ReadFrame(frame, eti_frame))
+			continue;
+
+		std::this_thread::sleep_until(next_frame_time);
+		next_frame_time += std::chrono::milliseconds(24);
+
+		// drop the frame, if the position was changed meanwhile
+		{
+			std::lock_guard<std::mutex> lock(status_mutex);
+
+			if(read_count != frame)
+				continue;
+			read_count = frame + 1;
+		}
+
+		observer->ETIProcessFrame(eti_frame);
+	}
+}
@@ -0,0 +1,101 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_TIMESHIFT_H_
+#define ETI_TIMESHIFT_H_
+
+// support 2GB+ files on 32bit systems
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "eti_source.h"
+
+
+// --- ETITimeshift -----------------------------------------------------------------
+/* Sits between an ETISource and its observer and keeps the last ETI frames
+ * within a ring file (mapped into memory), whose size equals the desired
+ * timeshift window. The most recent frames are additionally kept in a
+ * small ring in RAM, so that playback near the live position never has to
+ * touch the disk.
+ *
+ * The source (writer) only copies the frame and publishes the new frame
+ * count, so it never waits for the reader. The frames are passed on to the
+ * observer by an own (paced) reader thread, which can be paused and moved
+ * within the window. If the reader falls out of the window, it continues
+ * with the oldest frame still available.
+ */
+class ETITimeshift : public ETISourceObserver {
+private:
+	ETISourceObserver *observer;
+
+	size_t window_frames;
+	int ring_fd;
+	uint8_t *ring_map;
+	uint8_t *hot_ring;
+	std::atomic<size_t> write_count;
+
+	std::atomic<bool> do_exit;
+	std::mutex status_mutex;
+	std::condition_variable status_cond;
+	bool paused;
+	bool reset_pacing;
+	size_t read_count;
+
+	std::thread reader_thread;
+
+	void ReaderLoop();
+	bool ReadFrame(size_t frame, uint8_t *eti_frame);
+	size_t GetOldestFrame(size_t frames_written);
+	void UpdateProgress(size_t frame, size_t frames_written);
+
+	static const size_t eti_frame_len = 6144;
+	static const size_t hot_ring_frames = 256;	// ~6s
+public:
+	ETITimeshift(ETISourceObserver *observer, size_t window_frames);
+	~ETITimeshift();
+
+	bool Open();
+	void DoExit();
+	void Reset();
+	void WaitCaughtUp();
+
+	void Pause(bool pause);
+	bool IsPaused();
+	void Skip(int seconds);
+	void Seek(size_t frame);
+	void CatchUp();
+
+	// writer side
+	void ETIProcessFrame(const uint8_t *data);
+};
+
+
+
+#endif /* ETI_TIMESHIFT_H_ */
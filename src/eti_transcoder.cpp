@@ -0,0 +1,224 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eti_transcoder.h"
+
+
+// --- ETITranscoderOutput -----------------------------------------------------------------
+void ETITranscoderOutput::PutAudio(const uint8_t *data, size_t len) {
+	// discard audio decoded during warm-up (covered by the previous chunk)
+	if(frame < first_frame)
+		return;
+
+	audio.insert(audio.end(), data, data + len);
+}
+
+
+// --- ETITranscoder -----------------------------------------------------------------
+const size_t ETITranscoder::scan_frames;
+
+ETITranscoder::ETITranscoder(std::string filename, int jobs) {
+	this->filename = filename;
+	this->jobs = jobs;
+
+	input_fd = -1;
+	input_map = NULL;
+	input_map_len = 0;
+	frame_total = 0;
+
+	do_exit = false;
+	chunk_count = 0;
+	chunk_next = 0;
+	chunk_written = 0;
+
+	scan_fic_decoder = NULL;
+	scan_sid = LISTED_SERVICE::sid_none;
+	scan_scids = LISTED_SERVICE::scids_none;
+}
+
+ETITranscoder::~ETITranscoder() {
+	// cleanup
+	if(input_map && munmap((void*) input_map, input_map_len))
+		perror("ETITranscoder: error unmapping input file");
+	if(input_fd != -1)
+		close(input_fd);
+}
+
+void ETITranscoder::DoExit() {
+	// (also called from signal handlers, so no locking; all waits time out periodically)
+	do_exit = true;
+}
+
+bool ETITranscoder::Open() {
+	input_fd = open(filename.c_str(), O_RDONLY);
+	if(input_fd == -1) {
+		perror("ETITranscoder: error opening input file");
+		return false;
+	}
+
+	// chunks can only be processed independently with random access
+	struct stat file_stat;
+	if(fstat(input_fd, &file_stat)) {
+		perror("ETITranscoder: error getting file status");
+		return false;
+	}
+	if(!S_ISREG(file_stat.st_mode)) {
+		fprintf(stderr, "ETITranscoder: input is not a regular file\n");
+		return false;
+	}
+
+	frame_total = file_stat.st_size / eti_frame_len;
+	if(frame_total == 0) {
+		fprintf(stderr, "ETITranscoder: input file does not contain a complete frame\n");
+		return false;
+	}
+
+	input_map_len = file_stat.st_size;
+	void *map = mmap(NULL, input_map_len, PROT_READ, MAP_SHARED, input_fd, 0);
+	if(map == MAP_FAILED) {
+		perror("ETITranscoder: error mapping input file");
+		return false;
+	}
+	input_map = (const uint8_t*) map;
+
+	fprintf(stderr, "ETITranscoder: reading %zu frames from '%s' using %d job(s)\n", frame_total, filename.c_str(), jobs);
+	return true;
+}
+
+AUDIO_SERVICE ETITranscoder::FindAudioService(int sid, int scids) {
+	// process the FIC at the beginning of the recording, until the service is found
+	FICDecoder fic_decoder(this);
+	scan_fic_decoder = &fic_decoder;
+	scan_sid = sid;
+	scan_scids = scids;
+	scan_audio_service = AUDIO_SERVICE();
+
+	ETIPlayer player(new ETITranscoderOutput(0), this);
+	for(size_t frame = 0; frame < std::min(frame_total, scan_frames) && scan_audio_service.IsNone(); frame++)
+		player.ProcessFrame(input_map + frame * eti_frame_len);
+
+	scan_fic_decoder = NULL;
+	return scan_audio_service;
+}
+
+void ETITranscoder::FICChangeService(const LISTED_SERVICE& service) {
+	if(service.sid == scan_sid && service.scids == scan_scids)
+		scan_audio_service = service.audio_service;
+}
+
+int ETITranscoder::Main(const AUDIO_SERVICE& audio_service) {
+	this->audio_service = audio_service;
+
+	std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+	chunk_count = (frame_total + chunk_frames - 1) / chunk_frames;
+	chunk_next = 0;
+	chunk_written = 0;
+
+	std::vector<std::thread> workers;
+	for(int i = 0; i < jobs; i++)
+		workers.push_back(std::thread(&ETITranscoder::Worker, this));
+
+	// output the decoded chunks in order
+	std::vector<uint8_t> audio;
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(status_mutex);
+
+			while(!do_exit && chunk_written < chunk_count && chunk_audio.find(chunk_written) == chunk_audio.end())
+				status_cond.wait_for(lock, std::chrono::milliseconds(100));
+			if(do_exit || chunk_written == chunk_count)
+				break;
+
+			std::map<size_t, std::vector<uint8_t>>::iterator it = chunk_audio.find(chunk_written);
+			audio.swap(it->second);
+			chunk_audio.erase(it);
+			chunk_written++;
+
+			// allow workers to proceed
+			status_cond.notify_all();
+		}
+
+		if(!audio.empty())
+			fwrite(&audio[0], audio.size(), 1, stdout);
+		audio.clear();
+
+		// compensate cursor movement
+		fprintf(stderr, "\x1B[34m" "%5.1f%%" "\x1B[0m" "\b\b\b\b\b\b", (double) chunk_written / (double) chunk_count * 100);
+	}
+
+	for(std::thread& worker : workers)
+		worker.join();
+
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	double fps = duration > 0 ? frame_total / duration : 0;
+	fprintf(stderr, "ETITranscoder: processed %zu frames in %.3f s (%.1f frames/s = %.1fx real-time)\n", frame_total, duration, fps, fps * 0.024);
+
+	return 0;
+}
+
+void ETITranscoder::Worker() {
+	for(;;) {
+		size_t chunk;
+		{
+			std::unique_lock<std::mutex> lock(status_mutex);
+
+			// limit the number of decoded chunks waiting for output
+			while(!do_exit && chunk_next < chunk_count && chunk_next >= chunk_written + 2 * jobs)
+				status_cond.wait_for(lock, std::chrono::milliseconds(100));
+			if(do_exit || chunk_next == chunk_count)
+				return;
+
+			chunk = chunk_next++;
+		}
+
+		std::vector<uint8_t> audio;
+		DecodeChunk(chunk, audio);
+
+		{
+			std::lock_guard<std::mutex> lock(status_mutex);
+
+			chunk_audio[chunk].swap(audio);
+			status_cond.notify_all();
+		}
+	}
+}
+
+void ETITranscoder::DecodeChunk(size_t chunk, std::vector<uint8_t>& audio) {
+	size_t first_frame = chunk * chunk_frames;
+	size_t end_frame = std::min(first_frame + chunk_frames, frame_total);
+
+	// start a bit earlier, so that sync/decoder state is established at the chunk start
+	size_t warmup_frame = first_frame >= chunk_overlap_frames ? first_frame - chunk_overlap_frames : 0;
+
+	/* Each output is assigned to the frame which completed it. As all chunks
+	 * see the same frames around a chunk border, the audio is split there
+	 * without gaps or overlaps.
+	 */
+	ETIPlayerObserver player_observer;
+	ETITranscoderOutput *out = new ETITranscoderOutput(first_frame);
+	ETIPlayer player(out, &player_observer);
+	player.SetAudioService(audio_service);
+
+	for(size_t frame = warmup_frame; frame < end_frame; frame++) {
+		out->SetFrame(frame);
+		player.ProcessFrame(input_map + frame * eti_frame_len);
+	}
+
+	out->TakeAudio(audio);
+}
@@ -0,0 +1,115 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ETI_TRANSCODER_H_
+#define ETI_TRANSCODER_H_
+
+// support 2GB+ files on 32bit systems
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "audio_output.h"
+#include "eti_player.h"
+#include "fic_decoder.h"
+#include "tools.h"
+
+
+// --- ETITranscoderOutput -----------------------------------------------------------------
+class ETITranscoderOutput : public AudioOutput {
+private:
+	size_t first_frame;
+	size_t frame;
+	std::vector<uint8_t> audio;
+public:
+	ETITranscoderOutput(size_t first_frame) : first_frame(first_frame), frame(0) {}
+
+	void SetFrame(size_t frame) {this->frame = frame;}
+	void TakeAudio(std::vector<uint8_t>& audio) {audio.swap(this->audio);}
+
+	void StartAudio(int /*samplerate*/, int /*channels*/, bool /*float32*/) {}
+	void PutAudio(const uint8_t *data, size_t len);
+	void SetAudioMute(bool /*audio_mute*/) {}
+	void SetAudioVolume(double /*audio_volume*/) {}
+	bool HasAudioVolumeControl() {return false;}
+};
+
+
+// --- ETITranscoder -----------------------------------------------------------------
+class ETITranscoder : ETIPlayerObserver, FICDecoderObserver {
+private:
+	std::string filename;
+	int jobs;
+
+	int input_fd;
+	const uint8_t *input_map;
+	size_t input_map_len;
+	size_t frame_total;
+
+	AUDIO_SERVICE audio_service;
+
+	std::atomic<bool> do_exit;
+	std::mutex status_mutex;
+	std::condition_variable status_cond;
+	size_t chunk_count;
+	size_t chunk_next;
+	size_t chunk_written;
+	std::map<size_t, std::vector<uint8_t>> chunk_audio;
+
+	// service lookup
+	FICDecoder *scan_fic_decoder;
+	int scan_sid;
+	int scan_scids;
+	AUDIO_SERVICE scan_audio_service;
+
+	void ETIProcessFIC(const uint8_t *data, size_t len) {scan_fic_decoder->Process(data, len);}
+	void FICChangeService(const LISTED_SERVICE& service);
+
+	void Worker();
+	void DecodeChunk(size_t chunk, std::vector<uint8_t>& audio);
+
+	static const size_t eti_frame_len = 6144;
+	static const size_t chunk_frames = 2500;		// 60s
+	static const size_t chunk_overlap_frames = 50;	// 1.2s for Superframe sync and decoder warm-up
+	static const size_t scan_frames = 2500;
+public:
+	ETITranscoder(std::string filename, int jobs);
+	~ETITranscoder();
+
+	bool Open();
+	AUDIO_SERVICE FindAudioService(int sid, int scids);
+	int Main(const AUDIO_SERVICE& audio_service);
+	void DoExit();
+};
+
+
+
+#endif /* ETI_TRANSCODER_H_ */
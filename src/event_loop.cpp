@@ -0,0 +1,96 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "event_loop.h"
+
+
+// --- EventLoop -----------------------------------------------------------------
+EventLoop::EventLoop() {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(epoll_fd == -1)
+		perror("EventLoop: error creating epoll instance");
+
+	wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(wakeup_fd == -1)
+		perror("EventLoop: error creating eventfd");
+	else
+		Add(wakeup_fd, wakeup_id);
+}
+
+EventLoop::~EventLoop() {
+	if(wakeup_fd != -1)
+		close(wakeup_fd);
+	if(epoll_fd != -1)
+		close(epoll_fd);
+}
+
+bool EventLoop::Add(int fd, int id, uint32_t events) {
+	epoll_event event = {};
+	event.events = events;
+	event.data.u64 = (uint32_t) id;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+		// regular files cannot be waited for (they are always readable)
+		if(errno != EPERM)
+			perror("EventLoop: error adding fd");
+		return false;
+	}
+	return true;
+}
+
+bool EventLoop::Remove(int fd) {
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL)) {
+		perror("EventLoop: error removing fd");
+		return false;
+	}
+	return true;
+}
+
+void EventLoop::Wakeup() {
+	// async-signal-safe
+	uint64_t value = 1;
+	if(write(wakeup_fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+		perror("EventLoop: error signalling wakeup");
+}
+
+int EventLoop::Wait(std::vector<int>& ready_ids, int timeout_ms) {
+	ready_ids.clear();
+
+	epoll_event events[max_events];
+	int count = epoll_wait(epoll_fd, events, max_events, timeout_ms);
+	if(count == -1) {
+		// interruption by a signal is like a wakeup
+		if(errno == EINTR)
+			return 0;
+		perror("EventLoop: error while epoll_wait");
+		return -1;
+	}
+
+	for(int i = 0; i < count; i++) {
+		int id = (int) (uint32_t) events[i].data.u64;
+		if(id == wakeup_id) {
+			// reset the wakeup
+			uint64_t value;
+			if(read(wakeup_fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+				perror("EventLoop: error resetting wakeup");
+			continue;
+		}
+		ready_ids.push_back(id);
+	}
+	return ready_ids.size();
+}
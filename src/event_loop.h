@@ -0,0 +1,59 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_LOOP_H_
+#define EVENT_LOOP_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+// --- EventLoop -----------------------------------------------------------------
+/* Waits (via epoll) until any of the added fds becomes readable, or until
+ * Wakeup() is called. As the latter only writes to an eventfd, it can be
+ * called from any thread and even from a signal handler - so a waiting
+ * thread needs no periodic timeout to notice e.g. an exit request.
+ *
+ * Each fd is added with an ID, so that several inputs can be multiplexed
+ * within the same loop.
+ */
+class EventLoop {
+private:
+	int epoll_fd;
+	int wakeup_fd;
+
+	static const int wakeup_id = -1;
+	static const int max_events = 16;
+public:
+	EventLoop();
+	~EventLoop();
+
+	bool Add(int fd, int id, uint32_t events = EPOLLIN);
+	bool Remove(int fd);
+	void Wakeup();
+	int Wait(std::vector<int>& ready_ids, int timeout_ms = -1);
+};
+
+
+
+#endif /* EVENT_LOOP_H_ */
@@ -47,7 +47,7 @@ void PCMOutput::PutAudio(const uint8_t *data, size_t len) {
 	std::lock_guard<std::mutex> lock(audio_mute_mutex);
 
 	if(!audio_mute)
-//		fwrite(data, len, 1, stdout);  //cyang modify 
+		fwrite(data, len, 1, stdout);
 }
 
 void PCMOutput::SetAudioMute(bool audio_mute) {
@@ -0,0 +1,254 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RS_CODEC_H_
+#define RS_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// --- RSIndexList -----------------------------------------------------------------
+// compile-time list of the indices 0 ... N-1
+template<int... I> struct RSIndexList {};
+template<int N, int... I> struct RSMakeIndexList : RSMakeIndexList<N - 1, N - 1, I...> {};
+template<int... I> struct RSMakeIndexList<0, I...> {typedef RSIndexList<I...> type;};
+
+
+// --- RSTable -----------------------------------------------------------------
+// table of G::len entries, each one generated at compile time by G::Value(index)
+template<typename G, typename L = typename RSMakeIndexList<G::len>::type> struct RSTable;
+template<typename G, int... I> struct RSTable<G, RSIndexList<I...>> {
+	static constexpr uint8_t values[sizeof...(I)] = {G::Value(I)...};
+};
+template<typename G, int... I> constexpr uint8_t RSTable<G, RSIndexList<I...>>::values[sizeof...(I)];
+
+
+// --- RSUnroll -----------------------------------------------------------------
+// calls f(0) ... f(N-1) without a loop
+template<int N> struct RSUnroll {
+	template<typename F> static void Run(const F& f) {RSUnroll<N - 1>::Run(f); f(N - 1);}
+};
+template<> struct RSUnroll<0> {
+	template<typename F> static void Run(const F&) {}
+};
+
+
+// --- RSCodec -----------------------------------------------------------------
+// Reed-Solomon decoder for a (shortened) code with symbols of SYMSIZE bits, field
+// generator polynomial GFPOLY, first consecutive root alpha^FIRSTROOT (primitive
+// element alpha), NUMROOTS parity symbols and PADDING padding symbols - i.e. the
+// same code as by init_rs_char(SYMSIZE, GFPOLY, FIRSTROOT, 1, NUMROOTS, PADDING).
+// In contrast to the fec lib, all parameters are known at compile time, so
+// the log/antilog tables are generated by the compiler (and thus shared
+// read-only by all users) and the loops over the roots are unrolled.
+// The codeword symbols are accessed with a stride, so that an interleaved
+// codeword can be decoded in place.
+template<int SYMSIZE, int GFPOLY, int FIRSTROOT, int NUMROOTS, int PADDING>
+class RSCodec {
+public:
+	static constexpr int nn = (1 << SYMSIZE) - 1;
+	static constexpr int nroots = NUMROOTS;
+	static constexpr int len = nn - PADDING;		// len of the shortened codeword
+	static constexpr int max_errors = NUMROOTS / 2;
+
+	// compile-time field arithmetic (e.g. for further tables)
+	static constexpr int Next(int value) {
+		return (value << 1) & (1 << SYMSIZE) ? (value << 1) ^ GFPOLY : value << 1;
+	}
+	static constexpr int Alpha(int i, int value = 1) {
+		return i ? Alpha(i - 1, Next(value)) : value;
+	}
+	static constexpr int GFMul(int a, int b) {
+		return b ? ((b & 1 ? a : 0) ^ GFMul(Next(a), b >> 1)) : 0;
+	}
+private:
+	static_assert(SYMSIZE >= 2 && SYMSIZE <= 8, "RSCodec: symbol size not supported");
+	static_assert(PADDING >= 0 && NUMROOTS > 0 && NUMROOTS < len, "RSCodec: invalid codeword layout");
+	static_assert(FIRSTROOT >= 0 && FIRSTROOT + NUMROOTS <= nn, "RSCodec: invalid first consecutive root");
+
+	static constexpr int a0 = nn;				// log of zero
+
+	static constexpr int Log(int value, int i = 0, int alpha = 1) {
+		return (value == 0 || i == nn) ? a0 : alpha == value ? i : Log(value, i + 1, Next(alpha));
+	}
+
+	// antilog table doubled, so that the sum of two logs needs no modulo
+	struct AlphaToGen {
+		static constexpr int len = 2 * nn;
+		static constexpr uint8_t Value(int i) {return Alpha(i % nn);}
+	};
+	struct IndexOfGen {
+		static constexpr int len = nn + 1;
+		static constexpr uint8_t Value(int i) {return Log(i);}
+	};
+
+	static int AlphaTo(int i) {return RSTable<AlphaToGen>::values[i];}
+	static int IndexOf(int value) {return RSTable<IndexOfGen>::values[value];}
+	static int Modnn(int x) {return x % nn;}
+	static uint8_t Mul(uint8_t a, uint8_t b) {return (a && b) ? AlphaTo(IndexOf(a) + IndexOf(b)) : 0;}
+	static uint8_t Div(uint8_t a, uint8_t b) {return a ? AlphaTo(IndexOf(a) + nn - IndexOf(b)) : 0;}
+public:
+	// returns true, if any syndrome is non-zero
+	static bool CalcSyndromes(const uint8_t *data, size_t stride, uint8_t *syndromes);
+
+	// returns the number of corrected symbols (or -1, if uncorrectable);
+	// err_pos (optional) receives the positions within the shortened codeword
+	static int Correct(uint8_t *data, size_t stride, const uint8_t *syndromes, int *err_pos = NULL);
+
+	static int Decode(uint8_t *data, size_t stride = 1, int *err_pos = NULL) {
+		uint8_t syndromes[NUMROOTS];
+		if(!CalcSyndromes(data, stride, syndromes))
+			return 0;
+		return Correct(data, stride, syndromes, err_pos);
+	}
+};
+
+template<int SYMSIZE, int GFPOLY, int FIRSTROOT, int NUMROOTS, int PADDING>
+bool RSCodec<SYMSIZE, GFPOLY, FIRSTROOT, NUMROOTS, PADDING>::CalcSyndromes(
+		const uint8_t *data, size_t stride, uint8_t *syndromes) {
+	// Horner scheme: s_j = s_j * alpha^(FIRSTROOT+j) + r_pos
+	uint8_t s[NUMROOTS] = {0};
+	for(int pos = 0; pos < len; pos++) {
+		const uint8_t r = data[pos * stride];
+		RSUnroll<NUMROOTS>::Run([&](int j) {
+			s[j] = (s[j] ? AlphaTo(IndexOf(s[j]) + FIRSTROOT + j) : 0) ^ r;
+		});
+	}
+
+	uint8_t any = 0;
+	RSUnroll<NUMROOTS>::Run([&](int j) {
+		syndromes[j] = s[j];
+		any |= s[j];
+	});
+	return any;
+}
+
+template<int SYMSIZE, int GFPOLY, int FIRSTROOT, int NUMROOTS, int PADDING>
+int RSCodec<SYMSIZE, GFPOLY, FIRSTROOT, NUMROOTS, PADDING>::Correct(
+		uint8_t *data, size_t stride, const uint8_t *syndromes, int *err_pos) {
+	// Berlekamp-Massey: error locator polynomial lambda
+	uint8_t lambda[NUMROOTS + 1] = {1};
+	uint8_t prev_lambda[NUMROOTS + 1] = {1};
+	int lambda_deg = 0;
+	int shift = 1;
+	uint8_t prev_discr = 1;
+
+	for(int r = 0; r < NUMROOTS; r++) {
+		uint8_t discr = syndromes[r];
+		for(int i = 1; i <= lambda_deg; i++)
+			discr ^= Mul(lambda[i], syndromes[r - i]);
+
+		if(discr == 0) {
+			shift++;
+			continue;
+		}
+
+		uint8_t factor = Div(discr, prev_discr);
+		if(2 * lambda_deg <= r) {
+			uint8_t tmp[NUMROOTS + 1];
+			for(int i = 0; i <= NUMROOTS; i++)
+				tmp[i] = lambda[i];
+			for(int i = 0; i + shift <= NUMROOTS; i++)
+				lambda[i + shift] ^= Mul(factor, prev_lambda[i]);
+			for(int i = 0; i <= NUMROOTS; i++)
+				prev_lambda[i] = tmp[i];
+
+			lambda_deg = r + 1 - lambda_deg;
+			prev_discr = discr;
+			shift = 1;
+		} else {
+			for(int i = 0; i + shift <= NUMROOTS; i++)
+				lambda[i + shift] ^= Mul(factor, prev_lambda[i]);
+			shift++;
+		}
+	}
+
+	if(lambda_deg > max_errors || lambda[lambda_deg] == 0)
+		return -1;
+
+	// Chien search (only within the shortened codeword): the symbol at pos has
+	// the locator alpha^loc with loc = len - 1 - pos, so lambda(alpha^-loc) is
+	// evaluated incrementally (reg[i] = log(lambda[i]) - loc * i)
+	int reg[max_errors + 1];
+	RSUnroll<max_errors + 1>::Run([&](int i) {
+		reg[i] = lambda[i] ? Modnn(IndexOf(lambda[i]) + nn - Modnn((len - 1) * i)) : a0;
+	});
+
+	int root_loc[max_errors];
+	int root_count = 0;
+	for(int loc = len - 1; loc >= 0; loc--) {
+		uint8_t sum = 0;
+		RSUnroll<max_errors + 1>::Run([&](int i) {
+			if(reg[i] != a0) {
+				sum ^= AlphaTo(reg[i]);
+				reg[i] += i;
+				if(reg[i] >= nn)
+					reg[i] -= nn;
+			}
+		});
+		if(sum)
+			continue;
+
+		if(root_count == lambda_deg)
+			return -1;
+		root_loc[root_count++] = loc;
+	}
+	if(root_count != lambda_deg)
+		return -1;
+
+	// error evaluator polynomial omega = syndromes * lambda mod x^NUMROOTS
+	uint8_t omega[NUMROOTS];
+	for(int i = 0; i < NUMROOTS; i++) {
+		omega[i] = 0;
+		for(int k = 0; k <= i && k <= lambda_deg; k++)
+			omega[i] ^= Mul(syndromes[i - k], lambda[k]);
+	}
+
+	// Forney: error value = X^(1-FIRSTROOT) * omega(X^-1) / lambda'(X^-1)
+	for(int k = 0; k < root_count; k++) {
+		int loc = root_loc[k];
+		int inv_loc = Modnn(nn - loc);
+
+		uint8_t omega_value = 0;
+		for(int i = 0; i < NUMROOTS; i++)
+			if(omega[i])
+				omega_value ^= AlphaTo(Modnn(IndexOf(omega[i]) + inv_loc * i));
+
+		uint8_t lambda_deriv_value = 0;
+		for(int i = 1; i <= lambda_deg; i += 2)
+			if(lambda[i])
+				lambda_deriv_value ^= AlphaTo(Modnn(IndexOf(lambda[i]) + inv_loc * (i - 1)));
+		if(lambda_deriv_value == 0)
+			return -1;
+
+		uint8_t x_factor = AlphaTo(Modnn(loc * Modnn(nn + 1 - FIRSTROOT)));
+		uint8_t error = Mul(x_factor, Div(omega_value, lambda_deriv_value));
+
+		int pos = len - 1 - loc;
+		data[pos * stride] ^= error;
+		if(err_pos)
+			err_pos[k] = pos;
+	}
+
+	return root_count;
+}
+
+
+
+#endif /* RS_CODEC_H_ */
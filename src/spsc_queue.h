@@ -0,0 +1,98 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+
+// --- SPSCQueue -----------------------------------------------------------------
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Items are preallocated and filled/processed in place; the mutex is only
+// used to put a thread to sleep while it has to wait for the other side.
+template<typename T>
+class SPSCQueue {
+private:
+	T *items;
+	size_t capacity;
+
+	std::atomic<size_t> write_count;
+	std::atomic<size_t> read_count;
+	std::atomic<bool> aborted;
+
+	std::atomic<int> waiters;
+	std::mutex wait_mutex;
+	std::condition_variable wait_cond;
+
+	void Notify() {
+		if(waiters.load()) {
+			std::lock_guard<std::mutex> lock(wait_mutex);
+			wait_cond.notify_all();
+		}
+	}
+
+	template<typename P>
+	bool Wait(P ready) {
+		while(!ready()) {
+			if(aborted.load())
+				return false;
+
+			waiters++;
+			{
+				std::unique_lock<std::mutex> lock(wait_mutex);
+				wait_cond.wait_for(lock, std::chrono::milliseconds(10), [&]{return ready() || aborted.load();});
+			}
+			waiters--;
+		}
+		return true;
+	}
+public:
+	SPSCQueue(size_t capacity) : capacity(capacity), write_count(0), read_count(0), aborted(false), waiters(0) {items = new T[capacity];}
+	~SPSCQueue() {delete[] items;}
+
+	size_t Capacity() const {return capacity;}
+	bool IsEmpty() const {return read_count.load() == write_count.load();}
+	bool IsFull() const {return write_count.load() - read_count.load() == capacity;}
+
+	// producer side
+	T* WriteItem() {return IsFull() ? NULL : &items[write_count.load() % capacity];}
+	void Commit() {write_count++; Notify();}
+	bool WaitWritable() {return Wait([&]{return !IsFull();});}
+
+	// consumer side
+	T* ReadItem() {return IsEmpty() ? NULL : &items[read_count.load() % capacity];}
+	void Release() {read_count++; Notify();}
+	bool WaitReadable() {return Wait([&]{return !IsEmpty();});}
+
+	// any side
+	bool WaitEmpty() {return Wait([&]{return IsEmpty();});}
+	void Abort() {
+		aborted = true;
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		wait_cond.notify_all();
+	}
+};
+
+
+
+#endif /* SPSC_QUEUE_H_ */
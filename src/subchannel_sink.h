@@ -24,6 +24,14 @@
 
 #define FPAD_LEN 2
 
+// output of the encoded audio (instead of decoding it);
+// DAB services are always passed through as MP2 frames
+enum PASSTHROUGH_FORMAT {
+	PASSTHROUGH_NONE,
+	PASSTHROUGH_ADTS,	// DAB+: AUs as ADTS frames
+	PASSTHROUGH_LATM	// DAB+: AUs as LATM/LOAS frames
+};
+
 // --- SubchannelSinkObserver -----------------------------------------------------------------
 class SubchannelSinkObserver {
 public:
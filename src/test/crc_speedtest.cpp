@@ -0,0 +1,96 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "tools.h"
+
+
+typedef void (CalcCRC::*process_bytes_t)(uint16_t& crc, const uint8_t *data, size_t len);
+
+static const size_t data_len = 6144;
+static uint8_t data[data_len];
+
+
+static bool check(CalcCRC& calc_crc, const char *name) {
+	// compare the backends against the byte-wise LUT
+	for(size_t len = 0; len <= data_len; len += (len < 300 ? 1 : 97)) {
+		for(size_t offset = 0; offset < 3; offset++) {
+			if(offset + len > data_len)
+				break;
+
+			uint16_t crc_init = rand();
+			uint16_t crc_lut = crc_init;
+			uint16_t crc_slicing = crc_init;
+			uint16_t crc_clmul = crc_init;
+			uint16_t crc_auto = crc_init;
+			calc_crc.ProcessBytesLUT(crc_lut, data + offset, len);
+			calc_crc.ProcessBytesSlicing(crc_slicing, data + offset, len);
+			calc_crc.ProcessBytesCLMUL(crc_clmul, data + offset, len);
+			calc_crc.ProcessBytes(crc_auto, data + offset, len);
+
+			if(crc_slicing != crc_lut || crc_clmul != crc_lut || crc_auto != crc_lut) {
+				printf("%s: mismatch at len %zu, offset %zu: LUT 0x%04X, slicing 0x%04X, CLMUL 0x%04X, auto 0x%04X\n",
+						name, len, offset, crc_lut, crc_slicing, crc_clmul, crc_auto);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static double measure(CalcCRC& calc_crc, process_bytes_t process_bytes, size_t len) {
+	size_t trials = 200000000 / (len + 16);
+	uint16_t crc = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < trials; i++)
+		(calc_crc.*process_bytes)(crc, data, len);
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// prevent the loop from being optimized away
+	data[0] ^= crc & 0x01;
+
+	return trials * len / duration / 1e6;
+}
+
+int main() {
+	srand(1);
+	for(size_t i = 0; i < data_len; i++)
+		data[i] = rand();
+
+	printf("CLMUL support: %s\n", CalcCRC::HasCLMUL() ? "yes" : "no");
+
+	if(!check(CalcCRC::CalcCRC_CRC16_CCITT, "CRC16-CCITT") || !check(CalcCRC::CalcCRC_CRC16_IBM, "CRC16-IBM") || !check(CalcCRC::CalcCRC_FIRE_CODE, "Fire code"))
+		return 1;
+	printf("All backends match the byte-wise LUT\n");
+
+	// FIB, DAB+ AU, ETI frame body
+	const size_t lens[] = {30, 300, 6000};
+	for(size_t len : lens) {
+		double lut = measure(CalcCRC::CalcCRC_CRC16_CCITT, &CalcCRC::ProcessBytesLUT, len);
+		double slicing = measure(CalcCRC::CalcCRC_CRC16_CCITT, &CalcCRC::ProcessBytesSlicing, len);
+		double selected = measure(CalcCRC::CalcCRC_CRC16_CCITT, &CalcCRC::ProcessBytes, len);
+		printf("%4zu bytes: LUT %7.1f MB/s, slicing-by-8 %7.1f MB/s (%.1fx), selected %7.1f MB/s (%.1fx)\n",
+				len, lut, slicing, slicing / lut, selected, selected / lut);
+	}
+
+	return 0;
+}
@@ -0,0 +1,408 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+extern "C" {
+#include <fec.h>
+}
+
+#include "edi_source.h"
+#include "tools.h"
+
+
+static const size_t frame_count = 60;
+static const size_t stream_count = 2;
+static const int stream_scids[stream_count] = {3, 17};
+static const int stream_sads[stream_count] = {0, 60};
+static const int stream_tpls[stream_count] = {0x22, 0x05};
+static const size_t stream_lens[stream_count] = {480, 192};
+static const size_t fic_len = 96;
+static const uint16_t mnsc = 0x1234;
+
+static const size_t pft_fragments = 12;
+static const size_t pft_rs_k = 180;		// shortened, to also cover the padding
+
+static uint8_t get_pattern(size_t frame, size_t stream, size_t pos) {
+	return frame * 7 + stream * 31 + pos;
+}
+
+
+// --- FrameChecker -----------------------------------------------------------------
+// checks the rebuilt ETI frames against the content of the sent AF packets
+class FrameChecker : public ETISourceObserver {
+public:
+	std::vector<size_t> frames;
+	std::atomic<size_t> frame_count;
+	size_t wrong_frames;
+
+	FrameChecker() : frame_count(0), wrong_frames(0) {}
+
+	void ETIProcessFrame(const uint8_t *data) {
+		size_t frame = data[4];
+		if(!CheckFrame(data, frame)) {
+			fprintf(stderr, "edi_source_test: wrong frame %zu\n", frame);
+			wrong_frames++;
+		}
+		frames.push_back(frame);
+		frame_count++;
+	}
+
+	bool CheckFrame(const uint8_t *data, size_t frame) {
+		uint32_t fsync = data[1] << 16 | data[2] << 8 | data[3];
+		if(data[0] != 0xFF || fsync != (frame % 2 ? 0xF8C549 : 0x073AB6))
+			return false;
+
+		size_t fl = fic_len / 4 + stream_count + 1;
+		for(size_t s = 0; s < stream_count; s++)
+			fl += stream_lens[s] / 4;
+		if(data[5] != (0x80 | stream_count) || data[6] != ((frame % 8) << 5 | 1 << 3 | fl >> 8) || data[7] != (fl & 0xFF))
+			return false;
+
+		const uint8_t *stc = data + 8;
+		for(size_t s = 0; s < stream_count; s++, stc += 4) {
+			size_t stl = stream_lens[s] / 8;
+			if(stc[0] != (stream_scids[s] << 2 | stream_sads[s] >> 8) || stc[1] != (stream_sads[s] & 0xFF) || stc[2] != (stream_tpls[s] << 2 | stl >> 8) || stc[3] != (stl & 0xFF))
+				return false;
+		}
+
+		uint16_t header_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(data + 4, stc + 2 - (data + 4));
+		if((stc[0] << 8 | stc[1]) != mnsc || (stc[2] << 8 | stc[3]) != header_crc)
+			return false;
+
+		const uint8_t *mst = stc + 4;
+		size_t offset = 0;
+		for(size_t pos = 0; pos < fic_len; pos++)
+			if(mst[offset++] != get_pattern(frame, 0, pos))
+				return false;
+		for(size_t s = 0; s < stream_count; s++)
+			for(size_t pos = 0; pos < stream_lens[s]; pos++)
+				if(mst[offset++] != get_pattern(frame, s + 1, pos))
+					return false;
+
+		uint16_t body_crc = CalcCRC::CalcCRC_CRC16_CCITT.Calc(mst, offset);
+		const uint8_t *eof = mst + offset;
+		uint32_t tsta = frame * 100;
+		return (eof[0] << 8 | eof[1]) == body_crc && eof[4] == (tsta >> 16) && eof[5] == ((tsta >> 8) & 0xFF) && eof[6] == (tsta & 0xFF);
+	}
+
+	bool WaitFrames(size_t count) {
+		for(int i = 0; i < 500 && frame_count < count; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return frame_count == count;
+	}
+};
+
+
+// --- EDIPacketRecorder -----------------------------------------------------------------
+// creates the packets a multiplexer would send
+class EDIPacketRecorder {
+private:
+	static void Append(std::vector<uint8_t>& data, uint32_t value, int bytes) {
+		for(int i = bytes - 1; i >= 0; i--)
+			data.push_back(value >> (8 * i));
+	}
+
+	static void AppendCRC(std::vector<uint8_t>& data, size_t start) {
+		Append(data, CalcCRC::CalcCRC_CRC16_CCITT.Calc(&data[start], data.size() - start), 2);
+	}
+
+	static void AppendTagItem(std::vector<uint8_t>& data, const char *name, const std::vector<uint8_t>& value) {
+		data.insert(data.end(), name, name + 4);
+		Append(data, value.size() * 8, 4);
+		data.insert(data.end(), value.begin(), value.end());
+	}
+public:
+	static std::vector<uint8_t> CreateAFPacket(size_t frame) {
+		std::vector<uint8_t> payload;
+		std::vector<uint8_t> value;
+
+		value.assign({'D', 'E', 'T', 'I', 0x00, 0x00, 0x00, 0x00});
+		AppendTagItem(payload, "*ptr", value);
+
+		// ATSTF + FICF, no RFUDF
+		value.clear();
+		Append(value, 0xC000 | (frame / 250) << 8 | frame % 250, 2);
+		Append(value, 0xFFU << 24 | 1 << 22 | (frame % 8) << 19 | mnsc, 4);
+		Append(value, 0x00, 1);
+		Append(value, 0x12345678, 4);
+		Append(value, frame * 100, 3);
+		for(size_t pos = 0; pos < fic_len; pos++)
+			value.push_back(get_pattern(frame, 0, pos));
+		AppendTagItem(payload, "deti", value);
+
+		for(size_t s = 0; s < stream_count; s++) {
+			value.clear();
+			Append(value, stream_scids[s] << 18 | stream_sads[s] << 8 | stream_tpls[s] << 2, 3);
+			for(size_t pos = 0; pos < stream_lens[s]; pos++)
+				value.push_back(get_pattern(frame, s + 1, pos));
+			char name[] = {'e', 's', 't', (char) (s + 1)};
+			AppendTagItem(payload, name, value);
+		}
+
+		std::vector<uint8_t> packet = {'A', 'F'};
+		Append(packet, payload.size(), 4);
+		Append(packet, frame, 2);
+		packet.push_back(0x80 | 1 << 4);
+		packet.push_back('T');
+		packet.insert(packet.end(), payload.begin(), payload.end());
+		AppendCRC(packet, 0);
+		return packet;
+	}
+
+	static std::vector<std::vector<uint8_t>> CreatePFTFragments(const std::vector<uint8_t>& af_packet, uint16_t pseq) {
+		// RS packet: data chunks (last one zero padded), followed by the parity bytes
+		const size_t c = (af_packet.size() + pft_rs_k - 1) / pft_rs_k;
+		const size_t z = c * pft_rs_k - af_packet.size();
+		std::vector<uint8_t> rs_packet(af_packet);
+		rs_packet.resize(c * (pft_rs_k + 48), 0x00);
+
+		void *rs = init_rs_char(8, 0x11D, 0, 1, 48, 255 - 48 - pft_rs_k);
+		for(size_t n = 0; n < c; n++)
+			encode_rs_char(rs, &rs_packet[n * pft_rs_k], &rs_packet[c * pft_rs_k + n * 48]);
+		free_rs_char(rs);
+
+		// interleaved fragments
+		const size_t f = pft_fragments;
+		const size_t plen = (rs_packet.size() + f - 1) / f;
+		std::vector<std::vector<uint8_t>> fragments;
+		for(size_t i = 0; i < f; i++) {
+			std::vector<uint8_t> fragment = {'P', 'F'};
+			Append(fragment, pseq, 2);
+			Append(fragment, i, 3);
+			Append(fragment, f, 3);
+			Append(fragment, 0x8000 | plen, 2);
+			Append(fragment, pft_rs_k, 1);
+			Append(fragment, z, 1);
+			AppendCRC(fragment, 0);
+			for(size_t j = 0; j < plen; j++)
+				fragment.push_back(j * f + i < rs_packet.size() ? rs_packet[j * f + i] : 0x00);
+			fragments.push_back(fragment);
+		}
+		return fragments;
+	}
+};
+
+
+// --- EDIPacketReplayer -----------------------------------------------------------------
+// sends recorded packets, dropping some of them
+class EDIPacketReplayer {
+private:
+	std::vector<std::vector<uint8_t>> packets;
+	std::vector<bool> drops;
+public:
+	void Record(const std::vector<uint8_t>& packet, bool drop = false) {
+		packets.push_back(packet);
+		drops.push_back(drop);
+	}
+
+	void Replay(int fd) {
+		for(size_t i = 0; i < packets.size(); i++) {
+			if(drops[i])
+				continue;
+			if(send(fd, &packets[i][0], packets[i].size(), MSG_NOSIGNAL) != (ssize_t) packets[i].size()) {
+				perror("edi_source_test: error sending");
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+};
+
+
+static int create_socket(int type, uint16_t port, sockaddr_in& addr) {
+	int fd = socket(AF_INET, type, 0);
+	if(fd == -1) {
+		perror("edi_source_test: error creating socket");
+		return -1;
+	}
+
+	addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return fd;
+}
+
+static uint16_t get_free_port(int type) {
+	sockaddr_in addr;
+	int fd = create_socket(type, 0, addr);
+	if(fd == -1)
+		return 0;
+
+	socklen_t addr_len = sizeof(addr);
+	if(bind(fd, (sockaddr*) &addr, sizeof(addr)) || getsockname(fd, (sockaddr*) &addr, &addr_len))
+		perror("edi_source_test: error getting free port");
+	close(fd);
+	return ntohs(addr.sin_port);
+}
+
+static bool check_frames(const char *name, FrameChecker& checker, const std::vector<size_t>& expected_frames) {
+	bool result = checker.WaitFrames(expected_frames.size()) && checker.frames == expected_frames && !checker.wrong_frames;
+	if(!result)
+		fprintf(stderr, "edi_source_test: %s: %zu of %zu frames, %zu wrong frames\n", name, checker.frame_count.load(), expected_frames.size(), checker.wrong_frames);
+	return result;
+}
+
+static bool check_udp(const char *name, EDIPacketReplayer& replayer, const std::vector<size_t>& expected_frames) {
+	uint16_t port = get_free_port(SOCK_DGRAM);
+	FrameChecker checker;
+	EDISource source("edi+udp://127.0.0.1:" + std::to_string(port), &checker);
+	std::thread source_thread(&EDISource::Main, &source);
+
+	// datagrams are lost, until the source is ready
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	sockaddr_in addr;
+	int fd = create_socket(SOCK_DGRAM, port, addr);
+	if(fd != -1 && !connect(fd, (sockaddr*) &addr, sizeof(addr)))
+		replayer.Replay(fd);
+	bool result = check_frames(name, checker, expected_frames);
+	if(fd != -1)
+		close(fd);
+
+	source.DoExit();
+	source_thread.join();
+	return result;
+}
+
+static bool check_pft_udp() {
+	// PFT with lost fragments: up to two per packet can be recovered
+	EDIPacketReplayer replayer;
+	std::vector<size_t> expected_frames;
+	replayer.Record(std::vector<uint8_t>(100, 'P'));
+	for(size_t frame = 0; frame < frame_count; frame++) {
+		std::vector<std::vector<uint8_t>> fragments = EDIPacketRecorder::CreatePFTFragments(EDIPacketRecorder::CreateAFPacket(frame), 1000 + frame);
+		size_t dropped = 0;
+		for(size_t i = 0; i < fragments.size(); i++) {
+			bool drop = false;
+			if(frame % 5 == 1)
+				drop |= i == 3;
+			if(frame % 7 == 2)
+				drop |= i == 0 || i == fragments.size() - 1;
+			if(frame == 40)
+				drop |= i >= 1 && i <= 3;
+			replayer.Record(fragments[i], drop);
+			dropped += drop;
+
+			// a duplicate is ignored
+			if(frame == 10 && i == 5)
+				replayer.Record(fragments[i]);
+		}
+		if(dropped <= 2)
+			expected_frames.push_back(frame);
+	}
+
+	return check_udp("PFT via UDP", replayer, expected_frames);
+}
+
+static bool check_pft_interleaved_udp() {
+	// PFT with the fragments of each packet spread over three packet intervals;
+	// within an interval, the fragments of the (up to) three packets alternate,
+	// the newest packet first (so fragments of packets N and N+2 are interleaved)
+	const size_t spread = 3;
+	const size_t per_interval = (pft_fragments + spread - 1) / spread;
+	std::vector<std::vector<uint8_t>> slots((frame_count + spread - 1) * per_interval * spread);
+	std::vector<bool> slot_drops(slots.size());
+	std::vector<size_t> expected_frames;
+	for(size_t frame = 0; frame < frame_count; frame++) {
+		std::vector<std::vector<uint8_t>> fragments = EDIPacketRecorder::CreatePFTFragments(EDIPacketRecorder::CreateAFPacket(frame), 2000 + frame);
+		size_t dropped = 0;
+		for(size_t i = 0; i < fragments.size(); i++) {
+			bool drop = false;
+			if(frame % 4 == 1)
+				drop |= i == 2;
+			if(frame % 9 == 3)
+				drop |= i == 4 || i == 7;
+			if(frame == 30)
+				drop |= i >= 8;
+			size_t slot = ((frame + i % spread) * per_interval + i / spread) * spread + i % spread;
+			slots[slot] = fragments[i];
+			slot_drops[slot] = drop;
+			dropped += drop;
+		}
+		if(dropped <= 2)
+			expected_frames.push_back(frame);
+	}
+
+	EDIPacketReplayer replayer;
+	replayer.Record(std::vector<uint8_t>(100, 'P'));
+	for(size_t slot = 0; slot < slots.size(); slot++)
+		if(!slots[slot].empty())
+			replayer.Record(slots[slot], slot_drops[slot]);
+
+	return check_udp("interleaved PFT via UDP", replayer, expected_frames);
+}
+
+static bool check_af_tcp() {
+	// AF packets as stream, with junk and a corrupted packet in between
+	EDIPacketReplayer replayer;
+	std::vector<size_t> expected_frames;
+	for(size_t frame = 0; frame < frame_count; frame++) {
+		std::vector<uint8_t> packet = EDIPacketRecorder::CreateAFPacket(frame);
+		if(frame == 20)
+			packet[500] ^= 0x01;
+		else
+			expected_frames.push_back(frame);
+		if(frame % 10 == 0)
+			replayer.Record(std::vector<uint8_t>(frame + 3, 'A'));
+		replayer.Record(packet);
+	}
+
+	sockaddr_in addr;
+	int listen_fd = create_socket(SOCK_STREAM, 0, addr);
+	socklen_t addr_len = sizeof(addr);
+	if(listen_fd == -1 || bind(listen_fd, (sockaddr*) &addr, sizeof(addr)) || listen(listen_fd, 1) || getsockname(listen_fd, (sockaddr*) &addr, &addr_len)) {
+		perror("edi_source_test: error setting up server");
+		return false;
+	}
+
+	FrameChecker checker;
+	EDISource source("edi+tcp://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)), &checker);
+	std::thread source_thread(&EDISource::Main, &source);
+
+	int fd = accept(listen_fd, NULL, NULL);
+	replayer.Replay(fd);
+	bool result = check_frames("AF via TCP", checker, expected_frames);
+	close(fd);
+
+	source.DoExit();
+	source_thread.join();
+	close(listen_fd);
+	return result;
+}
+
+int main() {
+	bool ok = true;
+	ok &= check_pft_udp();
+	ok &= check_pft_interleaved_udp();
+	ok &= check_af_tcp();
+
+	fprintf(stderr, "edi_source_test: %s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#!/bin/sh
+# Fake DAB live source for tests: instead of ETI-NI frames, outputs frames
+# of the same size which start with the frequency (first arg), at the
+# usual frame rate. With "ignore-term" as second arg, SIGTERM is ignored.
+
+freq="$1"
+if [ "$2" = "ignore-term" ]; then
+	trap '' TERM
+fi
+
+while :; do
+	printf '%-6144s' "$freq" || exit 1
+	sleep 0.024
+done
@@ -0,0 +1,127 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "child_process.h"
+#include "eti_source.h"
+
+
+// counts the frames of the fake DAB live source, which start with the frequency
+class FrameCounter : public ETISourceObserver {
+public:
+	std::string tag;
+	std::atomic<size_t> frames;
+	size_t wrong_frames;
+
+	FrameCounter(uint32_t freq) : tag(std::to_string(freq * 1000)), frames(0), wrong_frames(0) {}
+
+	void ETIProcessFrame(const uint8_t *data) {
+		if(!memcmp(data, tag.c_str(), tag.length()) && data[tag.length()] == ' ')
+			frames++;
+		else
+			wrong_frames++;
+	}
+};
+
+static bool check_concurrent_sources(const std::string& fake_binary) {
+	// several sessions of the same binary at once
+	const uint32_t freqs[] = {174928, 202928, 227360};
+	const size_t count = sizeof(freqs) / sizeof(freqs[0]);
+
+	std::vector<FrameCounter*> counters;
+	std::vector<DABLiveETISource*> sources;
+	std::vector<std::thread> threads;
+	for(size_t i = 0; i < count; i++) {
+		counters.push_back(new FrameCounter(freqs[i]));
+		sources.push_back(new DABLiveETISource(fake_binary, DAB_LIVE_SOURCE_CHANNEL(freqs[i], DAB_LIVE_SOURCE_CHANNEL::auto_gain), counters[i]));
+		threads.push_back(std::thread(&DABLiveETISource::Main, sources[i]));
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+	// stopping one session must not affect the others
+	sources[0]->DoExit();
+	threads[0].join();
+	delete sources[0];
+	size_t frames_before = counters[1]->frames;
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	bool others_alive = counters[1]->frames > frames_before;
+
+	bool result = others_alive;
+	if(!others_alive)
+		fprintf(stderr, "live_source_test: stopping one source affected the others\n");
+	for(size_t i = 0; i < count; i++) {
+		if(i > 0) {
+			sources[i]->DoExit();
+			threads[i].join();
+			delete sources[i];
+		}
+
+		if(counters[i]->frames < 5 || counters[i]->wrong_frames) {
+			fprintf(stderr, "live_source_test: source %zu: %zu frames, %zu wrong frames\n", i, counters[i]->frames.load(), counters[i]->wrong_frames);
+			result = false;
+		}
+		delete counters[i];
+	}
+	return result;
+}
+
+static bool check_kill_escalation(const std::string& fake_binary) {
+	// a child ignoring SIGTERM must be killed
+	ChildProcess process;
+	std::vector<std::string> args;
+	args.push_back(fake_binary);
+	args.push_back("0");
+	args.push_back("ignore-term");
+
+	int fd = process.Start(args);
+	if(fd == -1)
+		return false;
+
+	char buffer[6144];
+	bool result = read(fd, buffer, sizeof(buffer)) > 0;
+
+	process.Stop();
+	if(process.IsRunning()) {
+		fprintf(stderr, "live_source_test: child process still running after stop\n");
+		result = false;
+	}
+	close(fd);
+	return result;
+}
+
+int main(int argc, char **argv) {
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s <fake DAB live source>\n", argv[0]);
+		return 1;
+	}
+
+	bool ok = true;
+	ok &= check_concurrent_sources(argv[1]);
+	ok &= check_kill_escalation(argv[1]);
+
+	fprintf(stderr, "live_source_test: %s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
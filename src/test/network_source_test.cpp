@@ -0,0 +1,221 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "eti_network_source.h"
+
+
+static const size_t frame_len = 6144;
+
+// checks that the frames (numbered within the first FC bytes) arrive in order
+class FrameChecker : public ETISourceObserver {
+public:
+	std::atomic<size_t> frames;
+	size_t wrong_frames;
+	uint32_t next_index;
+
+	FrameChecker() : frames(0), wrong_frames(0), next_index(0) {}
+
+	void ETIProcessFrame(const uint8_t *data) {
+		uint32_t index = data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
+		if(index != next_index)
+			wrong_frames++;
+		next_index = index + 1;
+		frames++;
+	}
+
+	bool WaitFrames(size_t count) {
+		for(int i = 0; i < 500 && frames < count; i++)
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		return frames == count && !wrong_frames;
+	}
+};
+
+static std::vector<uint8_t> create_frames(uint32_t first, uint32_t count, size_t junk_len) {
+	// junk, followed by frames with alternating FSYNC
+	std::vector<uint8_t> data(junk_len, 0xAA);
+	for(uint32_t index = first; index < first + count; index++) {
+		std::vector<uint8_t> frame(frame_len, 0x00);
+		uint32_t fsync = index % 2 ? 0xF8C549 : 0x073AB6;
+		frame[0] = 0xFF;
+		frame[1] = fsync >> 16;
+		frame[2] = fsync >> 8;
+		frame[3] = fsync;
+		frame[4] = index >> 24;
+		frame[5] = index >> 16;
+		frame[6] = index >> 8;
+		frame[7] = index;
+		data.insert(data.end(), frame.begin(), frame.end());
+	}
+	return data;
+}
+
+static void send_chunked(int fd, const std::vector<uint8_t>& data, size_t chunk_len) {
+	for(size_t offset = 0; offset < data.size(); offset += chunk_len) {
+		size_t len = std::min(chunk_len, data.size() - offset);
+		if(send(fd, &data[offset], len, MSG_NOSIGNAL) != (ssize_t) len) {
+			perror("network_source_test: error sending");
+			return;
+		}
+		// don't overrun the receiver with datagrams
+		if(chunk_len < frame_len)
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+}
+
+static int create_socket(int type, uint16_t port, sockaddr_in& addr) {
+	int fd = socket(AF_INET, type, 0);
+	if(fd == -1) {
+		perror("network_source_test: error creating socket");
+		return -1;
+	}
+
+	addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	return fd;
+}
+
+static uint16_t get_free_port(int type) {
+	sockaddr_in addr;
+	int fd = create_socket(type, 0, addr);
+	if(fd == -1)
+		return 0;
+
+	socklen_t addr_len = sizeof(addr);
+	if(bind(fd, (sockaddr*) &addr, sizeof(addr)) || getsockname(fd, (sockaddr*) &addr, &addr_len))
+		perror("network_source_test: error getting free port");
+	close(fd);
+	return ntohs(addr.sin_port);
+}
+
+static bool check_tcp_client() {
+	// loopback server, closing the connection in between
+	sockaddr_in addr;
+	int listen_fd = create_socket(SOCK_STREAM, 0, addr);
+	socklen_t addr_len = sizeof(addr);
+	if(listen_fd == -1 || bind(listen_fd, (sockaddr*) &addr, sizeof(addr)) || listen(listen_fd, 1) || getsockname(listen_fd, (sockaddr*) &addr, &addr_len)) {
+		perror("network_source_test: error setting up server");
+		return false;
+	}
+
+	FrameChecker checker;
+	ETINetworkSource source("tcp://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)), &checker);
+	std::thread source_thread(&ETINetworkSource::Main, &source);
+
+	int fd = accept(listen_fd, NULL, NULL);
+	send_chunked(fd, create_frames(0, 50, 1000), 1000);
+	close(fd);
+
+	fd = accept(listen_fd, NULL, NULL);
+	send_chunked(fd, create_frames(50, 50, 333), 4096);
+	bool result = checker.WaitFrames(100);
+	close(fd);
+
+	source.DoExit();
+	source_thread.join();
+	close(listen_fd);
+
+	if(!result)
+		fprintf(stderr, "network_source_test: TCP client: %zu frames, %zu wrong frames\n", checker.frames.load(), checker.wrong_frames);
+	return result;
+}
+
+static bool check_tcp_server() {
+	uint16_t port = get_free_port(SOCK_STREAM);
+
+	FrameChecker checker;
+	ETINetworkSource source("tcp://@127.0.0.1:" + std::to_string(port), &checker);
+	std::thread source_thread(&ETINetworkSource::Main, &source);
+
+	// connect, as soon as the source listens
+	sockaddr_in addr;
+	int fd = -1;
+	for(int i = 0; i < 100 && fd == -1; i++) {
+		fd = create_socket(SOCK_STREAM, port, addr);
+		if(connect(fd, (sockaddr*) &addr, sizeof(addr))) {
+			close(fd);
+			fd = -1;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	bool result = false;
+	if(fd != -1) {
+		send_chunked(fd, create_frames(0, 50, 5000), 7000);
+		result = checker.WaitFrames(50);
+		close(fd);
+	}
+
+	source.DoExit();
+	source_thread.join();
+
+	if(!result)
+		fprintf(stderr, "network_source_test: TCP server: %zu frames, %zu wrong frames\n", checker.frames.load(), checker.wrong_frames);
+	return result;
+}
+
+static bool check_udp() {
+	uint16_t port = get_free_port(SOCK_DGRAM);
+
+	FrameChecker checker;
+	ETINetworkSource source("udp://127.0.0.1:" + std::to_string(port), &checker);
+	std::thread source_thread(&ETINetworkSource::Main, &source);
+
+	// datagrams are lost, until the source is ready
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+	sockaddr_in addr;
+	int fd = create_socket(SOCK_DGRAM, port, addr);
+	bool result = false;
+	if(fd != -1 && !connect(fd, (sockaddr*) &addr, sizeof(addr))) {
+		send_chunked(fd, create_frames(0, 100, 700), 1472);
+		result = checker.WaitFrames(100);
+	}
+	if(fd != -1)
+		close(fd);
+
+	source.DoExit();
+	source_thread.join();
+
+	if(!result)
+		fprintf(stderr, "network_source_test: UDP: %zu frames, %zu wrong frames\n", checker.frames.load(), checker.wrong_frames);
+	return result;
+}
+
+int main() {
+	bool ok = true;
+	ok &= check_tcp_client();
+	ok &= check_tcp_server();
+	ok &= check_udp();
+
+	fprintf(stderr, "network_source_test: %s\n", ok ? "OK" : "FAILED");
+	return ok ? 0 : 1;
+}
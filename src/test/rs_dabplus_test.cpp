@@ -0,0 +1,243 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2017 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+extern "C" {
+#include <fec.h>
+}
+
+#include "dabplus_rs.h"
+
+
+static void *rs_handle;
+
+static void encode_superframe(std::vector<uint8_t>& sf, int codewords) {
+	uint8_t rs_packet[120];
+
+	for(int i = 0; i < codewords; i++) {
+		for(int pos = 0; pos < 110; pos++)
+			rs_packet[pos] = rand();
+		encode_rs_char(rs_handle, rs_packet, rs_packet + 110);
+		for(int pos = 0; pos < 120; pos++)
+			sf[pos * codewords + i] = rs_packet[pos];
+	}
+}
+
+static int decode_codeword(const std::vector<uint8_t>& sf, int codewords, int i) {
+	uint8_t rs_packet[120];
+	for(int pos = 0; pos < 120; pos++)
+		rs_packet[pos] = sf[pos * codewords + i];
+	return decode_rs_char(rs_handle, rs_packet, NULL, 0);
+}
+
+static bool check(RSSyndromeCalculator::Backend backend, int codewords, int trials) {
+	RSSyndromeCalculator calc_ref;
+	RSSyndromeCalculator calc;
+	calc_ref.SetBackend(RSSyndromeCalculator::BACKEND_SCALAR);
+	calc.SetBackend(backend);
+
+	std::vector<uint8_t> sf(codewords * 120);
+	for(int trial = 0; trial < trials; trial++) {
+		encode_superframe(sf, codewords);
+
+		// add up to five errors to some codewords (thus always correctable)
+		std::vector<bool> errors(codewords);
+		if(trial % 2) {
+			for(int i = 0; i < codewords; i++) {
+				if(rand() % 3)
+					continue;
+				int count = 1 + rand() % 5;
+				for(int e = 0; e < count; e++)
+					sf[(rand() % 120) * codewords + i] ^= 1 + rand() % 255;
+				errors[i] = decode_codeword(sf, codewords, i) != 0;
+			}
+		}
+
+		bool dirty_ref = calc_ref.Calc(&sf[0], codewords);
+		bool dirty = calc.Calc(&sf[0], codewords);
+		if(dirty != dirty_ref) {
+			printf("%s, %d codewords: dirty state mismatch\n", RSSyndromeCalculator::GetBackendName(backend), codewords);
+			return false;
+		}
+
+		for(int i = 0; i < codewords; i++) {
+			for(int j = 0; j < RSSyndromeCalculator::nroots; j++) {
+				if(calc.GetSyndrome(i, j) != calc_ref.GetSyndrome(i, j)) {
+					printf("%s, %d codewords: syndrome %d of codeword %d mismatch\n", RSSyndromeCalculator::GetBackendName(backend), codewords, j, i);
+					return false;
+				}
+			}
+
+			// compare with the general decoder
+			if(calc.IsCodewordDirty(i) != errors[i]) {
+				printf("%s, %d codewords: codeword %d is %s, but the general decoder disagrees\n",
+						RSSyndromeCalculator::GetBackendName(backend), codewords, i, errors[i] ? "clean" : "dirty");
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool check_correction(int codewords, int trials) {
+	RSSyndromeCalculator calc;
+	uint8_t syndromes[RSSyndromeCalculator::nroots];
+
+	std::vector<uint8_t> sf(codewords * 120);
+	std::vector<uint8_t> sf_orig;
+	std::vector<uint8_t> rs_packet(120);
+	for(int trial = 0; trial < trials; trial++) {
+		encode_superframe(sf, codewords);
+		sf_orig = sf;
+
+		// add up to eight errors to each codeword (thus not always correctable)
+		int max_errors = trial % 2 ? 8 : 5;
+		for(int i = 0; i < codewords; i++) {
+			int count = rand() % (max_errors + 1);
+			for(int e = 0; e < count; e++)
+				sf[(rand() % 120) * codewords + i] ^= 1 + rand() % 255;
+		}
+
+		calc.Calc(&sf[0], codewords);
+		for(int i = 0; i < codewords; i++) {
+			for(int pos = 0; pos < 120; pos++)
+				rs_packet[pos] = sf[pos * codewords + i];
+			int count_ref = decode_rs_char(rs_handle, &rs_packet[0], NULL, 0);
+
+			int count = 0;
+			if(calc.IsCodewordDirty(i)) {
+				calc.GetSyndromes(i, syndromes);
+				count = DABPlusRSCodec::Correct(&sf[i], codewords, syndromes);
+			}
+
+			// the general decoder may also accept error positions within the padding
+			if(count != count_ref && !(count == -1 && count_ref > 0)) {
+				printf("%d codewords: codeword %d corrected with count %d (general decoder: %d)\n", codewords, i, count, count_ref);
+				return false;
+			}
+			if(count == -1)
+				continue;
+			for(int pos = 0; pos < 120; pos++) {
+				uint8_t value = sf[pos * codewords + i];
+				if(value != rs_packet[pos] || (max_errors <= 5 && value != sf_orig[pos * codewords + i])) {
+					printf("%d codewords: codeword %d wrongly corrected at pos %d\n", codewords, i, pos);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+static void measure(RSSyndromeCalculator::Backend backend, int codewords) {
+	RSSyndromeCalculator calc;
+	calc.SetBackend(backend);
+
+	std::vector<uint8_t> sf(codewords * 120);
+	encode_superframe(sf, codewords);
+
+	int trials = 500000 / codewords;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int trial = 0; trial < trials; trial++) {
+		if(calc.Calc(&sf[0], codewords))
+			printf("unexpected error\n");
+	}
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for(int trial = 0; trial < trials / 10; trial++)
+		for(int i = 0; i < codewords; i++)
+			decode_codeword(sf, codewords, i);
+	double duration_general = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 10;
+
+	printf("%-6s %3d codewords: %8.0f clean Superframes/s (general decoder: %8.0f/s = %.1fx)\n",
+			RSSyndromeCalculator::GetBackendName(backend), codewords, trials / duration, trials / duration_general, duration_general / duration);
+}
+
+static void measure_codec(int errors) {
+	std::vector<uint8_t> sf(120);
+	encode_superframe(sf, 1);
+	for(int e = 0; e < errors; e++)
+		sf[e * 23] ^= 0x5A;
+
+	// both decoders correct a copy of the same codeword
+	const int trials = 200000;
+	std::vector<uint8_t> rs_packet(120);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(int trial = 0; trial < trials; trial++) {
+		rs_packet = sf;
+		if(DABPlusRSCodec::Decode(&rs_packet[0]) != errors)
+			printf("unexpected result\n");
+	}
+	double duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	start = std::chrono::steady_clock::now();
+	for(int trial = 0; trial < trials; trial++) {
+		rs_packet = sf;
+		if(decode_rs_char(rs_handle, &rs_packet[0], NULL, 0) != errors)
+			printf("unexpected result\n");
+	}
+	double duration_general = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("RSCodec %d errors: %8.0f codewords/s (general decoder: %8.0f/s = %.1fx)\n",
+			errors, trials / duration, trials / duration_general, duration_general / duration);
+}
+
+int main() {
+	srand(1);
+
+	rs_handle = init_rs_char(8, 0x11D, 0, 1, 10, 135);
+	if(!rs_handle) {
+		printf("init_rs_char failed!\n");
+		return 1;
+	}
+
+	RSSyndromeCalculator::Backend detected = RSSyndromeCalculator().GetBackend();
+	printf("Detected backend: %s\n", RSSyndromeCalculator::GetBackendName(detected));
+
+	const int codeword_counts[] = {1, 3, 6, 12, 16, 17, 24, 31, 32, 33, 48, 341};
+	for(int backend = RSSyndromeCalculator::BACKEND_SCALAR; backend <= detected; backend++) {
+		for(int codewords : codeword_counts) {
+			if(!check((RSSyndromeCalculator::Backend) backend, codewords, 50))
+				return 1;
+		}
+		printf("Backend %s: all syndromes match\n", RSSyndromeCalculator::GetBackendName((RSSyndromeCalculator::Backend) backend));
+	}
+
+	for(int codewords : codeword_counts) {
+		if(!check_correction(codewords, 50))
+			return 1;
+	}
+	printf("RSCodec: in-place correction matches the general decoder\n");
+
+	for(int backend = RSSyndromeCalculator::BACKEND_SCALAR; backend <= detected; backend++) {
+		measure((RSSyndromeCalculator::Backend) backend, 6);
+		measure((RSSyndromeCalculator::Backend) backend, 24);
+	}
+
+	for(int errors = 0; errors <= 5; errors += 1)
+		measure_codec(errors);
+
+	free_rs_char(rs_handle);
+	return 0;
+}
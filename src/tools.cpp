@@ -32,6 +32,12 @@ string_vector_t MiscTools::SplitString(const std::string &s, const char delimite
 
 
 // --- CalcCRC -----------------------------------------------------------------
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CALCCRC_CLMUL
+#endif
+
+bool CalcCRC::clmul_available = CalcCRC::DetectCLMUL();
+
 CalcCRC CalcCRC::CalcCRC_CRC16_CCITT(true, true, 0x1021);	// 0001 0000 0010 0001 (16, 12, 5, 0)
 CalcCRC CalcCRC::CalcCRC_CRC16_IBM(true, false, 0x8005);	// 1000 0000 0000 0101 (16, 15, 2, 0)
 CalcCRC CalcCRC::CalcCRC_FIRE_CODE(false, false, 0x782F);	// 0111 1000 0010 1111 (16, 14, 13, 12, 11, 5, 3, 2, 1, 0)
@@ -44,6 +50,16 @@ CalcCRC::CalcCRC(bool initial_invert, bool final_invert, uint16_t gen_polynom) {
 	this->gen_polynom = gen_polynom;
 
 	FillLUT();
+	FillFoldConsts();
+}
+
+bool CalcCRC::DetectCLMUL() {
+#ifdef CALCCRC_CLMUL
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+#else
+	return false;
+#endif
 }
 
 void CalcCRC::FillLUT() {
@@ -57,17 +73,37 @@ void CalcCRC::FillLUT() {
 				crc = crc << 1;
 		}
 
-		crc_lut[value] = crc;
+		crc_lut[0][value] = crc;
 	}
+
+	// LUT n: byte followed by n zero bytes
+	for(int n = 1; n < 8; n++)
+		for(int value = 0; value < 256; value++)
+			crc_lut[n][value] = (crc_lut[n - 1][value] << 8) ^ crc_lut[0][crc_lut[n - 1][value] >> 8];
+}
+
+uint16_t CalcCRC::CalcXPowMod(size_t exp) {
+	// x^exp mod P (with P = x^16 + generator polynom)
+	uint32_t result = 1;
+	for(size_t i = 0; i < exp; i++) {
+		result <<= 1;
+		if(result & 0x10000)
+			result ^= 0x10000 | gen_polynom;
+	}
+	return result;
+}
+
+void CalcCRC::FillFoldConsts() {
+	fold_consts[0] = CalcXPowMod(128 + 64);
+	fold_consts[1] = CalcXPowMod(128);
+	fold_consts[2] = CalcXPowMod(512 + 64);
+	fold_consts[3] = CalcXPowMod(512);
 }
 
 uint16_t CalcCRC::Calc(const uint8_t *data, size_t len) {
 	uint16_t crc;
 	Initialize(crc);
-
-	for(size_t offset = 0; offset < len; offset++)
-		ProcessByte(crc, data[offset]);
-
+	ProcessBytes(crc, data, len);
 	Finalize(crc);
 	return crc;
 }
@@ -78,12 +114,99 @@ void CalcCRC::ProcessBits(uint16_t& crc, const uint8_t *data, size_t len) {
 	size_t bytes = len / 8;
 	size_t bits = len % 8;
 
-	for(size_t offset = 0; offset < bytes; offset++)
-		ProcessByte(crc, data[offset]);
+	ProcessBytes(crc, data, bytes);
 	for(size_t bit = 0; bit < bits; bit++)
 		ProcessBit(crc, data[bytes] & (0x80 >> bit));
 }
 
+void CalcCRC::ProcessBytesLUT(uint16_t& crc, const uint8_t *data, size_t len) {
+	for(size_t offset = 0; offset < len; offset++)
+		ProcessByte(crc, data[offset]);
+}
+
+void CalcCRC::ProcessBytesSlicing(uint16_t& crc, const uint8_t *data, size_t len) {
+	uint16_t result = crc;
+
+	// process eight bytes at once; the CRC affects only the first two of them
+	for(; len >= 8; data += 8, len -= 8) {
+		result =
+				crc_lut[7][data[0] ^ (result >> 8)] ^
+				crc_lut[6][data[1] ^ (result & 0xFF)] ^
+				crc_lut[5][data[2]] ^
+				crc_lut[4][data[3]] ^
+				crc_lut[3][data[4]] ^
+				crc_lut[2][data[5]] ^
+				crc_lut[1][data[6]] ^
+				crc_lut[0][data[7]];
+	}
+
+	for(; len; data++, len--)
+		ProcessByte(result, *data);
+
+	crc = result;
+}
+
+#ifdef CALCCRC_CLMUL
+#include <immintrin.h>
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i LoadBlockCLMUL(const uint8_t *data) {
+	// first byte becomes the most significant one
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) data), _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i FoldCLMUL(__m128i value, __m128i consts) {
+	// (high * x^64 + low) * x^n = high * (x^(n+64) mod P) + low * (x^n mod P)
+	return _mm_xor_si128(_mm_clmulepi64_si128(value, consts, 0x11), _mm_clmulepi64_si128(value, consts, 0x00));
+}
+
+__attribute__((target("pclmul,ssse3")))
+void CalcCRC::ProcessBytesCLMUL(uint16_t& crc, const uint8_t *data, size_t len) {
+	if(len < clmul_min_len) {
+		ProcessBytesSlicing(crc, data, len);
+		return;
+	}
+
+	// the 128-bit values are only congruent to the processed data (mod P);
+	// the CRC register is added to the first two bytes
+	__m128i block[4];
+	for(int i = 0; i < 4; i++)
+		block[i] = LoadBlockCLMUL(data + i * 16);
+	block[0] = _mm_xor_si128(block[0], _mm_set_epi64x((uint64_t) crc << 48, 0));
+	data += 64;
+	len -= 64;
+
+	// fold four blocks in parallel by 512 bits
+	__m128i consts_512 = _mm_set_epi64x(fold_consts[2], fold_consts[3]);
+	for(; len >= 64; data += 64, len -= 64)
+		for(int i = 0; i < 4; i++)
+			block[i] = _mm_xor_si128(FoldCLMUL(block[i], consts_512), LoadBlockCLMUL(data + i * 16));
+
+	// combine them and fold the remaining blocks by 128 bits
+	__m128i consts_128 = _mm_set_epi64x(fold_consts[0], fold_consts[1]);
+	__m128i value = block[0];
+	for(int i = 1; i < 4; i++)
+		value = _mm_xor_si128(FoldCLMUL(value, consts_128), block[i]);
+	for(; len >= 16; data += 16, len -= 16)
+		value = _mm_xor_si128(FoldCLMUL(value, consts_128), LoadBlockCLMUL(data));
+
+	// final reduction by the LUT, then process the tail
+	uint8_t value_bytes[16];
+	_mm_storeu_si128((__m128i*) value_bytes, _mm_shuffle_epi8(value, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)));
+
+	uint16_t result = 0;
+	ProcessBytesSlicing(result, value_bytes, sizeof(value_bytes));
+	ProcessBytesSlicing(result, data, len);
+	crc = result;
+}
+#else
+void CalcCRC::ProcessBytesCLMUL(uint16_t& crc, const uint8_t *data, size_t len) {
+	// not supported on this platform
+	ProcessBytesSlicing(crc, data, len);
+}
+#endif
+
 
 // --- CircularBuffer -----------------------------------------------------------------
 CircularBuffer::CircularBuffer(size_t capacity) {
@@ -162,6 +285,48 @@ bool BitReader::GetBits(int& result, size_t count) {
 }
 
 
+// --- BitWriter -----------------------------------------------------------------
+bool BitWriter::AddBits(int value, size_t count) {
+	if((byte_len * 8 + data_bits + count + 7) / 8 > data_bytes)
+		return false;
+
+	while(count) {
+		size_t copy_bits = std::min(count, 8 - data_bits);
+		uint8_t bits = (value >> (count - copy_bits)) & (0xFF >> (8 - copy_bits));
+
+		if(data_bits == 0)
+			data[byte_len] = 0x00;
+		data[byte_len] |= bits << (8 - data_bits - copy_bits);
+
+		data_bits += copy_bits;
+		count -= copy_bits;
+
+		// switch to next byte
+		if(data_bits == 8) {
+			byte_len++;
+			data_bits = 0;
+		}
+	}
+	return true;
+}
+
+bool BitWriter::AddBytes(const uint8_t *bytes, size_t len) {
+	// byte-aligned: copy at once
+	if(data_bits == 0) {
+		if(byte_len + len > data_bytes)
+			return false;
+		memcpy(data + byte_len, bytes, len);
+		byte_len += len;
+		return true;
+	}
+
+	for(size_t i = 0; i < len; i++)
+		if(!AddBits(bytes[i], 8))
+			return false;
+	return true;
+}
+
+
 const dab_channels_t dab_channels {
 	{ "5A",  174928},
 	{ "5B",  176640},
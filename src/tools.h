@@ -44,8 +44,15 @@ private:
 	bool final_invert;
 	uint16_t gen_polynom;
 
-	uint16_t crc_lut[256];
+	uint16_t crc_lut[8][256];		// slicing-by-8 (first LUT = plain byte-wise LUT)
+	uint64_t fold_consts[4];		// x^(128+64), x^128, x^(512+64), x^512 mod P
 	void FillLUT();
+	void FillFoldConsts();
+	uint16_t CalcXPowMod(size_t exp);
+
+	static bool clmul_available;
+	static bool DetectCLMUL();
+	static const size_t clmul_min_len = 64;
 public:
 	CalcCRC(bool initial_invert, bool final_invert, uint16_t gen_polynom);
 	virtual ~CalcCRC() {}
@@ -56,10 +63,17 @@ public:
 	// modular API
 	void Initialize(uint16_t& crc);
 	void ProcessByte(uint16_t& crc, const uint8_t data);
+	void ProcessBytes(uint16_t& crc, const uint8_t *data, size_t len);
 	void ProcessBit(uint16_t& crc, const bool data);
 	void ProcessBits(uint16_t& crc, const uint8_t *data, size_t len);
 	void Finalize(uint16_t& crc);
 
+	// backends (usually selected by ProcessBytes)
+	void ProcessBytesLUT(uint16_t& crc, const uint8_t *data, size_t len);
+	void ProcessBytesSlicing(uint16_t& crc, const uint8_t *data, size_t len);
+	void ProcessBytesCLMUL(uint16_t& crc, const uint8_t *data, size_t len);
+	static bool HasCLMUL() {return clmul_available;}
+
 	static CalcCRC CalcCRC_CRC16_CCITT;
 	static CalcCRC CalcCRC_CRC16_IBM;
 	static CalcCRC CalcCRC_FIRE_CODE;
@@ -73,7 +87,14 @@ inline void CalcCRC::Initialize(uint16_t& crc) {
 
 inline void CalcCRC::ProcessByte(uint16_t& crc, const uint8_t data) {
 	// use LUT
-	crc = (crc << 8) ^ crc_lut[(crc >> 8) ^ data];
+	crc = (crc << 8) ^ crc_lut[0][(crc >> 8) ^ data];
+}
+
+inline void CalcCRC::ProcessBytes(uint16_t& crc, const uint8_t *data, size_t len) {
+	if(len >= clmul_min_len && clmul_available)
+		ProcessBytesCLMUL(crc, data, len);
+	else
+		ProcessBytesSlicing(crc, data, len);
 }
 
 inline void CalcCRC::ProcessBit(uint16_t& crc, const bool data) {
@@ -121,6 +142,22 @@ public:
 };
 
 
+// --- BitWriter -----------------------------------------------------------------
+class BitWriter {
+private:
+	uint8_t *data;
+	size_t data_bytes;
+	size_t byte_len;
+	size_t data_bits;
+public:
+	BitWriter(uint8_t *data, size_t data_bytes) : data(data), data_bytes(data_bytes), byte_len(0), data_bits(0) {}
+	bool AddBits(int value, size_t count);
+	bool AddBytes(const uint8_t *bytes, size_t len);
+	void AlignToByte() {if(data_bits) {byte_len++; data_bits = 0;}}
+	size_t GetByteLen() const {return byte_len + (data_bits ? 1 : 0);}
+};
+
+
 typedef std::map<std::string,uint32_t> dab_channels_t;
 extern const dab_channels_t dab_channels;
 